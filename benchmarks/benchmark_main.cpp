@@ -0,0 +1,227 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "converter_json.h"
+#include "corpus_generator.h"
+#include "inverted_index.h"
+#include "search_server.h"
+#include "tokenizer.h"
+
+namespace {
+
+CorpusSettings corpusSettings;          //!< set by the command line before the benchmarks are registered
+const size_t queriesNum = 1000;         //!< number of queries searched by one iteration of the search benchmarks
+
+/*!
+ * Corpus shared by the benchmarks, generated once for the settings of the command line
+ */
+struct Corpus {
+    std::vector<std::string> docs;
+    std::vector<std::string> queries;
+    std::shared_ptr<const InvertedIndex> index;
+    size_t bytes = 0;
+
+    static const Corpus &get() {
+        static Corpus corpus;
+        return corpus;
+    }
+
+private:
+    Corpus() {
+        CorpusGenerator generator(corpusSettings);
+        docs = generator.generateDocuments();
+        queries = generator.generateQueries(queriesNum);
+        for (auto &doc : docs)
+            bytes += doc.size();
+        auto built = std::make_shared<InvertedIndex>();
+        built->updateDocumentBase(docs);
+        built->waitForMerges();
+        index = built;
+    }
+};
+
+void setConfig(size_t cacheCapacity) {
+    if (!JSON::config.is_object())
+        JSON::config = nlohmann::json::object();
+    JSON::config["config"]["max_responses"] = 5;
+    JSON::config["config"]["search_threads"] = 1;
+    JSON::config["config"]["cache_capacity"] = cacheCapacity;
+}
+
+void BM_Tokenize(benchmark::State &state, ScannerType scanner) {
+    if (!Tokenizer::isSupported(scanner)) {
+        state.SkipWithError("the scanner is not supported by this processor");
+        return;
+    }
+    const Corpus &corpus = Corpus::get();
+    for (auto _ : state) {
+        size_t words = 0;
+        for (auto &doc : corpus.docs) {
+            Tokenizer tokenizer(TextView(doc.data(), doc.size()), false, scanner);
+            TextView word;
+            while (tokenizer.next(word))
+                words++;
+        }
+        benchmark::DoNotOptimize(words);
+    }
+    state.SetBytesProcessed((int64_t) (state.iterations() * corpus.bytes));
+}
+BENCHMARK_CAPTURE(BM_Tokenize, Scalar, ScannerType::Scalar)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Tokenize, SSE2, ScannerType::SSE2)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Tokenize, AVX2, ScannerType::AVX2)->Unit(benchmark::kMillisecond);
+
+void BM_UpdateDocumentBase(benchmark::State &state) {
+    const Corpus &corpus = Corpus::get();
+    for (auto _ : state) {
+        InvertedIndex index;
+        index.updateDocumentBase(corpus.docs);
+        benchmark::DoNotOptimize(index.getDocsAmount());
+    }
+    state.SetBytesProcessed((int64_t) (state.iterations() * corpus.bytes));
+    ///< The memory of the index is reported with the speed, so a change of the layout shows in the comparison
+    IndexMemoryStats stats = corpus.index->getMemoryStats(0);
+    state.counters["dictionary_bytes"] = (double) stats.dictionary.allocated;
+    state.counters["postings_bytes"] = (double) stats.postings.allocated;
+}
+BENCHMARK(BM_UpdateDocumentBase)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/*!
+ * The indexing of the corpus whose first document is as large as all the others together,
+ * the threads have to share the large document to finish in the time of the uniform corpus
+ */
+void BM_UpdateDocumentBaseSkewed(benchmark::State &state) {
+    static const std::vector<std::string> docs = [] () {
+        CorpusSettings settings = corpusSettings;
+        settings.largeDocWords = settings.docsNum * settings.docWords;
+        return CorpusGenerator(settings).generateDocuments();
+    }();
+    size_t bytes = 0;
+    for (auto &doc : docs)
+        bytes += doc.size();
+    for (auto _ : state) {
+        InvertedIndex index;
+        index.updateDocumentBase(docs);
+        benchmark::DoNotOptimize(index.getDocsAmount());
+    }
+    state.SetBytesProcessed((int64_t) (state.iterations() * bytes));
+}
+BENCHMARK(BM_UpdateDocumentBaseSkewed)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_GetWordCount(benchmark::State &state) {
+    const Corpus &corpus = Corpus::get();
+    InvertedIndex index = *corpus.index;
+    ///< The words are taken from the ranks spread over the vocabulary, from the most frequent one to the rarest
+    std::vector<std::string> words;
+    for (size_t rank = 1; rank <= corpusSettings.vocabularySize; rank *= 4)
+        words.push_back(CorpusGenerator::getWord(rank - 1));
+    size_t entries = 0;
+    for (auto _ : state) {
+        for (auto &word : words)
+            entries += index.getWordCount(word).size();
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * words.size()));
+    state.counters["entries"] = benchmark::Counter((double) entries, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_GetWordCount)->Unit(benchmark::kMicrosecond);
+
+/*!
+ * The search of a batch of queries, the argument is the capacity of the result cache
+ */
+void BM_Search(benchmark::State &state) {
+    const Corpus &corpus = Corpus::get();
+    setConfig((size_t) state.range(0));
+    SearchServer server(corpus.index);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(server.search(corpus.queries));
+    state.SetItemsProcessed((int64_t) (state.iterations() * corpus.queries.size()));
+    state.counters["hit_rate"] = server.getCacheStats().getHitRate();
+}
+BENCHMARK(BM_Search)->ArgName("cache")->Arg(0)->Arg(1024)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/*!
+ * The ranking of the found documents, the argument is the number of documents
+ */
+void BM_CalcRelative(benchmark::State &state) {
+    size_t found = (size_t) state.range(0);
+    std::vector<size_t> Ids(found), absolutes(found);
+    for (size_t i = 0; i < found; i++) {
+        Ids[i] = i;
+        absolutes[i] = (i * 7919) % 1000 + 1;
+    }
+    std::vector<RelativeIndex> indexes;
+    for (auto _ : state) {
+        indexes.clear();
+        SearchServer::calcRelative(Ids, absolutes, 5, indexes);
+        benchmark::DoNotOptimize(indexes.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * found));
+}
+BENCHMARK(BM_CalcRelative)->Arg(5)->Arg(100)->Arg(10000);
+
+void BM_AnswersJson(benchmark::State &state) {
+    const Corpus &corpus = Corpus::get();
+    setConfig(0);
+    SearchServer server(corpus.index);
+    auto answers = SearchServer::convert(server.search(corpus.queries));
+    ///< The answers are serialized into a string, answers.json of the working directory is left alone
+    for (auto _ : state) {
+        std::string text = ConverterJSON::getAnswersJson(answers).dump();
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * answers.size()));
+}
+BENCHMARK(BM_AnswersJson)->Unit(benchmark::kMillisecond);
+
+/*!
+ * The method reads a value of the corpus settings from the command line, the option is removed from argv.
+ * @param [in] name the name of the option with the leading dashes and the trailing '='
+ * @param [in, out] argc number of the arguments
+ * @param [in, out] argv the arguments
+ * @param [out] value the value, unchanged if the option is missing
+ */
+template<typename T>
+void readOption(const char *name, int &argc, char *argv[], T &value) {
+    size_t length = std::strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], name, length) != 0)
+            continue;
+        value = (T) std::strtod(argv[i] + length, nullptr);
+        for (int j = i; j + 1 < argc; j++)
+            argv[j] = argv[j + 1];
+        argc--;
+        return;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    readOption("--docs=", argc, argv, corpusSettings.docsNum);
+    readOption("--doc_words=", argc, argv, corpusSettings.docWords);
+    readOption("--large_doc_words=", argc, argv, corpusSettings.largeDocWords);
+    readOption("--vocabulary=", argc, argv, corpusSettings.vocabularySize);
+    readOption("--zipf=", argc, argv, corpusSettings.zipfExponent);
+    readOption("--query_words=", argc, argv, corpusSettings.queryWords);
+    readOption("--seed=", argc, argv, corpusSettings.seed);
+    if (corpusSettings.docsNum == 0 || corpusSettings.vocabularySize == 0) {
+        std::fprintf(stderr, "The corpus needs at least one document and one word\n");
+        return 1;
+    }
+    setConfig(0);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::AddCustomContext("docs", std::to_string(corpusSettings.docsNum));
+    benchmark::AddCustomContext("doc_words", std::to_string(corpusSettings.docWords));
+    benchmark::AddCustomContext("large_doc_words", std::to_string(corpusSettings.largeDocWords));
+    benchmark::AddCustomContext("vocabulary", std::to_string(corpusSettings.vocabularySize));
+    benchmark::AddCustomContext("zipf", std::to_string(corpusSettings.zipfExponent));
+    benchmark::AddCustomContext("query_words", std::to_string(corpusSettings.queryWords));
+    benchmark::AddCustomContext("seed", std::to_string(corpusSettings.seed));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*!
+ * \file
+ * \brief Header file describing the generator of synthetic documents and queries for the benchmarks
+ *
+ * Header file describing the generator of synthetic documents and queries for the benchmarks.
+ * The words follow Zipf's law like the words of a natural text. The generator uses its own arithmetic
+ * instead of the distributions of the standard library, so a seed gives the same corpus with every compiler
+ * and the results of different commits and machines can be compared.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/*!
+ * Settings of the synthetic corpus
+ */
+struct CorpusSettings {
+    size_t docsNum = 1000;          //!< number of documents
+    size_t docWords = 500;          //!< number of words in a document
+    size_t largeDocWords = 0;       //!< number of words in the first document, 0 - the same as in the others
+    size_t vocabularySize = 50000;  //!< number of distinct words
+    double zipfExponent = 1.0;      //!< exponent of Zipf's law, the frequency of the word of rank r is 1 / r^s
+    size_t queryWords = 3;          //!< number of words in a query
+    uint64_t seed = 2023;
+};
+
+/*!
+ * \brief Generator of the documents and queries of a synthetic corpus
+ *
+ * Generator of the documents and queries of a synthetic corpus.
+ * The word of rank r is made of letters that encode r, so the frequent words are short like in a natural text.
+ */
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusSettings &inSettings) : settings(inSettings), random(inSettings.seed) {
+        cumulative.resize(settings.vocabularySize);
+        double sum = 0;
+        for (size_t rank = 0; rank < settings.vocabularySize; rank++)
+            cumulative[rank] = sum += 1.0 / std::pow((double) (rank + 1), settings.zipfExponent);
+        for (auto &value : cumulative)
+            value /= sum;
+    }
+
+/*!
+ * The method for getting the word of a rank.
+ * @param [in] rank rank of the word, 0 is the most frequent word
+ * @return the word
+ */
+    static std::string getWord(size_t rank) {
+        std::string word;
+        for (size_t rest = rank + 1; rest != 0; rest = (rest - 1) / 26)
+            word += (char) ('a' + (rest - 1) % 26);
+        return word;
+    }
+
+/*!
+ * The method draws the rank of a word.
+ * @return the rank, the rank r is drawn with the probability proportional to 1 / (r + 1)^s
+ */
+    size_t nextRank() {
+        double uniform = (double) (random() >> 11) * (1.0 / 9007199254740992.0);
+        auto found = std::upper_bound(cumulative.begin(), cumulative.end(), uniform);
+        return std::min((size_t) (found - cumulative.begin()), settings.vocabularySize - 1);
+    }
+
+/*!
+ * The method generates the documents of the corpus.
+ * The first document may be larger than the others, so the corpus has the skewed sizes of real collections.
+ * @return the documents, the words are separated by spaces and a line ends every 12 words
+ */
+    std::vector<std::string> generateDocuments() {
+        std::vector<std::string> docs(settings.docsNum);
+        for (size_t docId = 0; docId < docs.size(); docId++) {
+            std::string &doc = docs[docId];
+            size_t wordsNum = (docId == 0 && settings.largeDocWords != 0 ? settings.largeDocWords : settings.docWords);
+            for (size_t i = 0; i < wordsNum; i++) {
+                doc += getWord(nextRank());
+                doc += (i % 12 == 11 ? '\n' : ' ');
+            }
+        }
+        return docs;
+    }
+
+/*!
+ * The method generates queries with the same distribution of the words as the documents.
+ * @param [in] queriesNum number of queries
+ * @return the queries
+ */
+    std::vector<std::string> generateQueries(size_t queriesNum) {
+        std::vector<std::string> queries(queriesNum);
+        for (auto &query : queries) {
+            for (size_t i = 0; i < settings.queryWords; i++) {
+                if (i != 0)
+                    query += ' ';
+                query += getWord(nextRank());
+            }
+        }
+        return queries;
+    }
+
+private:
+    CorpusSettings settings;
+    std::mt19937_64 random;          //!< the engine is defined by the standard, unlike the distributions
+    std::vector<double> cumulative;  //!< cumulative[r] is the probability of the ranks 0..r
+};
@@ -0,0 +1,111 @@
+/*!
+ * \file
+ * \brief Header file describing the BoundedQueue template class
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*!
+ * Statistics of a bounded queue
+ */
+struct QueueStats {
+    size_t capacity = 0;    //!< the highest number of items the queue holds
+    size_t maxDepth = 0;    //!< the highest number of items the queue held
+    size_t pushes = 0;      //!< number of items pushed
+    size_t depthSum = 0;    //!< sum of the depths seen by the pushed items, depthSum / pushes is the average depth
+    size_t fullWaits = 0;   //!< number of pushes that waited because the queue was full
+    size_t emptyWaits = 0;  //!< number of pops that waited because the queue was empty
+};
+
+/*!
+ * \brief Queue connecting the threads of two stages of a pipeline
+ *
+ * Queue connecting the threads of two stages of a pipeline.
+ * A producer waits while the queue is full, so a fast stage can't run ahead of a slow one and the memory
+ * held between the stages is bounded by the capacity. A consumer waits while the queue is empty and gets
+ * nothing once the queue is closed and drained.
+ * @tparam T type of the items
+ */
+template<typename T>
+class BoundedQueue {
+public:
+/*!
+ * @param [in] inCapacity the highest number of items the queue holds, at least 1
+ */
+    explicit BoundedQueue(size_t inCapacity) : capacity(inCapacity > 0 ? inCapacity : 1) {}
+
+/*!
+ * The method adds an item to the queue, waiting while the queue is full.
+ * @param [in] item the item
+ */
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(access);
+        if (items.size() >= capacity) {
+            stats.fullWaits++;
+            notFull.wait(lock, [this]() { return items.size() < capacity; });
+        }
+        items.push_back(std::move(item));
+        stats.pushes++;
+        stats.depthSum += items.size();
+        if (stats.maxDepth < items.size())
+            stats.maxDepth = items.size();
+        lock.unlock();
+        notEmpty.notify_one();
+    }
+
+/*!
+ * The method takes an item from the queue, waiting while the queue is empty and not closed.
+ * @param [out] item the item
+ * @return false if the queue is closed and has no items
+ */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(access);
+        if (items.empty() && !closed) {
+            stats.emptyWaits++;
+            notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        }
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+/*!
+ * The method tells the consumers that no more items will be pushed.
+ */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(access);
+            closed = true;
+        }
+        notEmpty.notify_all();
+    }
+
+/*!
+ * The method for getting the statistics of the queue.
+ * @return the statistics
+ */
+    QueueStats getStats() {
+        std::lock_guard<std::mutex> lock(access);
+        QueueStats result = stats;
+        result.capacity = capacity;
+        return result;
+    }
+
+private:
+    const size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    QueueStats stats;
+    std::mutex access;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
@@ -16,8 +16,12 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <fstream>
 #include "nlohmann/json.hpp"
 #include "status.h"
+#include "index_file.h"
+#include "ingest_pipeline.h"
 
 /*!
  *\brief Structure for storing static data in JSON format
@@ -84,6 +88,12 @@ public:
  */
     static std::vector<std::string> getTextDocuments();
 
+/*!
+ * The method for getting the paths of the files listed in config.json
+ * @return paths to the document files in the order of the list
+ */
+    static std::vector<std::string> getDocumentPaths();
+
 /*!
  * The method reads the max_responses field to determine 
  * the maximum number of responses per request
@@ -91,12 +101,124 @@ public:
  */
     static size_t getResponsesLimit();
 
+/*!
+ * The method reads the search_threads field to determine the number of threads
+ * that process the requests
+ * @return number of search threads, the number of hardware threads if the field is missing or is 0
+ */
+    static size_t getSearchThreadsNumber();
+
+/*!
+ * The method reads the cache_capacity field to determine how many results of the queries are cached
+ * @return number of cached results, 1024 if the field is missing, 0 disables the cache
+ */
+    static size_t getCacheCapacity();
+
+/*!
+ * The method reads the threads field to determine the size of the shared thread pool
+ * @return number of pool threads, 0 if the field is missing (the number of hardware threads is used)
+ */
+    static size_t getThreadsNumber();
+
+/*!
+ * The method reads the pin_threads field to determine whether the pool threads are pinned to the cores
+ * @return true if the threads are pinned, false if the field is missing
+ */
+    static bool isThreadsPinned();
+
+/*!
+ * The method reads the shards field to determine the number of worker processes searching the files
+ * @return number of shards, 0 if the field is missing (the files are searched by one index in this process)
+ */
+    static size_t getShardsNumber();
+
+/*!
+ * The method reads the size and the modification time of the files listed in config.json
+ * @return the files in the order of the list, a missing file has modification time -1
+ */
+    static std::vector<DocumentSource> getDocumentSources();
+
+/*!
+ * The method reads the index_path field to determine where the binary index is kept
+ * @return path to the index file, an empty string if the field is missing (the index is not saved)
+ */
+    static std::string getIndexPath();
+
+/*!
+ * The method reads the rebuild_index_if_changed field to determine whether a saved index is rebuilt
+ * when the files listed in config.json have changed since it was saved
+ * @return true if the index is rebuilt, true if the field is missing
+ */
+    static bool isIndexRebuiltIfChanged();
+
+/*!
+ * The method reads the verify_index field to determine whether the checksum of a saved index is checked on loading
+ * @return true if the checksum is checked, false if the field is missing
+ */
+    static bool isIndexVerified();
+
+/*!
+ * The method reads the lowercase field to determine whether the words are turned to lowercase,
+ * so that the words differing only in the case of ASCII letters are one word
+ * @return true if the words are turned to lowercase, false if the field is missing
+ */
+    static bool isLowercase();
+
+/*!
+ * The method reads the positions field to determine whether the positions of the words are indexed,
+ * so that the requests can search for phrases
+ * @return true if the positions are indexed, false if the field is missing
+ */
+    static bool isPositionsIndexed();
+
+/*!
+ * The method reads the ingest_readers, ingest_tokenizers, ingest_indexers, ingest_queue_depth,
+ * ingest_block_size and ingest_memory_budget fields to determine the settings of the ingestion pipeline
+ * @return the settings, a missing field is 0 (the default value is used)
+ */
+    static IngestSettings getIngestSettings();
+
+/*!
+ * The method reads the ingest_stats field to determine whether the statistics of the ingestion are printed
+ * @return true if the statistics are printed, false if the field is missing
+ */
+    static bool isIngestStatsPrinted();
+
+/*!
+ * The method reads the metrics_path field to determine the file the metrics are written to
+ * @return the path to the metrics file, an empty string if the field is missing
+ */
+    static std::string getMetricsPath();
+
 /*!
  * The method for receiving requests from the requests.json file
  * @return list of requests from requests.json file
  */
     static std::vector<std::string> getRequests();
 
+/*!
+ * The method converts the search result of one request to the JSON object of the answers.json file
+ * @param [in] i index of the request, starting from 0
+ * @param [in] answer the result of the request
+ * @return the object with the "requestNNN" field
+ */
+    static nlohmann::json getAnswerJson(size_t i, const std::vector<std::pair<size_t, double>> &answer);
+
+/*!
+ * The method converts search results to the JSON object written to the answers.json file
+ * @param [in] answers the results of the requests in the order of the requests
+ * @return the object with the "answers" field
+ */
+    static nlohmann::json getAnswersJson(const std::vector<std::vector<std::pair<size_t, double>>> &answers);
+
+/*!
+ * The method converts the statistics of an index to a JSON object, together with the bytes allocated
+ * in the whole process for every category of MemoryAccounting
+ * @param [in] stats the statistics
+ * @return the object
+ */
+    static nlohmann::json getIndexStatsJson(const IndexMemoryStats &stats);
+
 /*!
  * The method for putting search results in the answers.json file
  */
@@ -104,3 +226,79 @@ public:
     answers);
 };
 
+/*!
+ * \brief Reader of the requests from a JSON Lines file
+ *
+ * Reader of the requests from a JSON Lines file.
+ * Every line holds one request, either a JSON string or an object with the "request" string field, empty lines
+ * are skipped. The file is read in batches, so only one batch of requests is held in memory at a time.
+ */
+class RequestsReader {
+public:
+/*!
+ * The method opens the file.
+ * @param [in] path path to the file
+ * @return operation status:
+ * OK - the file is opened;
+ * ERROR - the file can't be opened.
+ */
+    status open(const std::string &path);
+
+/*!
+ * The method reads the next batch of requests. A line that is not a request is answered as an empty request,
+ * so the answers keep the numbers of the lines.
+ * @param [out] requests the requests of the batch
+ * @param [in] maxCount the highest number of requests in the batch
+ * @return number of requests in the batch, 0 at the end of the file
+ */
+    size_t read(std::vector<std::string> &requests, size_t maxCount);
+
+private:
+    std::ifstream file;
+    size_t lineNumber = 0;
+};
+
+/*!
+ * \brief Writer of the answers to a file in the shape of answers.json
+ *
+ * Writer of the answers to a file in the shape of answers.json.
+ * Every answer is written as soon as it is found, so the memory does not depend on the number of requests.
+ * The file is the same as the one written by ConverterJSON::putAnswers, except that no requests give
+ * {"answers":[]} instead of null.
+ */
+class AnswersWriter {
+public:
+    AnswersWriter() = default;
+
+    ~AnswersWriter();
+
+/*!
+ * The method creates the file and writes the beginning of the document.
+ * @param [in] path path to the file
+ * @return operation status:
+ * OK - the file is created;
+ * ERROR - the file can't be created.
+ */
+    status open(const std::string &path);
+
+/*!
+ * The method writes the answer of the next request.
+ * @param [in] answer the result of the request
+ * @return operation status:
+ * OK - the answer is written;
+ * ERROR - an error occurred while writing to the file.
+ */
+    status write(const std::vector<std::pair<size_t, double>> &answer);
+
+/*!
+ * The method writes the end of the document and closes the file.
+ * @return operation status:
+ * OK - the file is complete;
+ * ERROR - an error occurred while writing to the file.
+ */
+    status close();
+
+private:
+    std::ofstream file;
+    size_t written = 0; //!< number of the written answers
+};
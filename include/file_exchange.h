@@ -14,6 +14,9 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <memory>
+#include "mapped_file.h"
 #include "status.h"
 
 /*!
@@ -23,6 +26,8 @@ class FileExchange {
 public:
     FileExchange() = default;
 
+    static const size_t textBlockSize = 1 << 20; //!< size of the blocks in which text files are read
+
     /*!
      * The method for reading data from a file on the user's PC.
      * @tparam T data type (nlohmann::json, std::string)
@@ -37,6 +42,20 @@ public:
     template<typename T>
     static status readFromFile(T &object, const std::string &path, bool isText = false);
 
+    /*!
+     * The method maps a text file into memory, the text is used in place without being copied.
+     * @param [in] path path to data file
+     * @return the mapped file, nullptr if the file can't be opened
+     */
+    static std::unique_ptr<MappedFile> mapTextFile(const std::string &path);
+
+    /*!
+     * The method checks that a file can be opened for reading, the file is closed at once.
+     * @param [in] path path to data file
+     * @return true if the file can be opened, otherwise the error is printed like by the reading methods
+     */
+    static bool canOpen(const std::string &path);
+
     /*!
      * The method for writing data to a file on the user's PC.
      * @tparam T data type (nlohmann::json, std::string)
@@ -59,13 +78,13 @@ status FileExchange::readFromFile(T &object, const std::string &path, bool isTex
         if (!isText)
             file >> object;
         else {
-            std::string word;
-            while (true) {
-                file >> word;
-                object += word + ' ';
-                if (file.eof())
-                    break;
-            }
+            ///< The text is read in large blocks, the indexer splits it into words without copying
+            file.exceptions(std::ifstream::badbit); ///< the last block reaches the end of the file
+            std::string text;
+            std::vector<char> block(textBlockSize);
+            while (file.read(block.data(), (std::streamsize) block.size()) || file.gcount() > 0)
+                text.append(block.data(), (size_t) file.gcount());
+            object += text;
         }
         file.close();
         return status::OK;
@@ -78,6 +97,24 @@ status FileExchange::readFromFile(T &object, const std::string &path, bool isTex
     }
 }
 
+inline std::unique_ptr<MappedFile> FileExchange::mapTextFile(const std::string &path) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (file->open(path) != status::OK) {
+        std::cerr << "Can't open file: " << path << std::endl;
+        return nullptr;
+    }
+    return file;
+}
+
+inline bool FileExchange::canOpen(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Can't open file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
 template <typename T>
 status FileExchange::writeToFile(T &object, const std::string& path) {
     std::ofstream file;
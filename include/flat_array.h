@@ -0,0 +1,90 @@
+/*!
+ * \file
+ * \brief Header file describing the FlatArray template class
+ */
+
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include "memory_accounting.h"
+
+/*!
+ * \brief Contiguous array that either owns its elements or refers to elements stored elsewhere
+ *
+ * Contiguous array that either owns its elements or refers to elements stored elsewhere.
+ * An index that is being built owns its arrays, an index opened from a file refers to the memory-mapped
+ * file directly, so the same lookup code works on both without converting the file data.
+ * The owned elements are allocated by CountingAllocator, so the memory of the arrays is counted in MemoryAccounting.
+ * @tparam T type of the elements, it must be trivially copyable to be stored in a file
+ * @tparam category the category the memory of the array is counted in
+ */
+template<typename T, MemoryCategory category>
+class FlatArray {
+public:
+    typedef std::vector<T, CountingAllocator<T, category>> vector_t;
+
+    const T *data() const { return isBorrowed ? borrowed : owned.data(); }
+
+    size_t size() const { return isBorrowed ? borrowedSize : owned.size(); }
+
+    bool empty() const { return size() == 0; }
+
+/*!
+ * The method for getting the memory used by the array.
+ * @return the allocated capacity of the owned elements or the size of the external elements
+ */
+    MemoryUsage getMemoryUsage() const {
+        MemoryUsage usage;
+        usage.allocated = owned.capacity() * sizeof(T);
+        usage.mapped = isBorrowed ? borrowedSize * sizeof(T) : 0;
+        return usage;
+    }
+
+    const T &operator[](size_t i) const { return data()[i]; }
+
+/*!
+ * The method gives access to the owned elements for modification.
+ * It must not be called for an array that refers to external elements.
+ * @return the owned elements
+ */
+    vector_t &modify() {
+        assert (!isBorrowed);
+        return owned;
+    }
+
+/*!
+ * The method frees the unused capacity of the owned elements.
+ */
+    void shrinkToFit() {
+        owned.shrink_to_fit();
+    }
+
+/*!
+ * The method makes the array refer to external elements. The elements must outlive the array.
+ * @param [in] inData the first element
+ * @param [in] inSize number of elements
+ */
+    void attach(const T *inData, size_t inSize) {
+        vector_t().swap(owned);
+        isBorrowed = true;
+        borrowed = inData;
+        borrowedSize = inSize;
+    }
+
+/*!
+ * The method removes all the elements, the array owns its elements afterwards.
+ */
+    void clear() {
+        owned.clear();
+        isBorrowed = false;
+        borrowed = nullptr;
+        borrowedSize = 0;
+    }
+
+private:
+    vector_t owned;
+    bool isBorrowed = false;
+    const T *borrowed = nullptr;
+    size_t borrowedSize = 0;
+};
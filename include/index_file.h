@@ -0,0 +1,173 @@
+/*!
+ * \file
+ * \brief Header file declaring the binary index file format
+ *
+ * Header file declaring the binary index file format.
+ * The file starts with IndexFileHeader, followed by the table of sections and the sections themselves.
+ * Every section is an array stored exactly as it is laid out in memory and starts at an offset that is
+ * a multiple of 8, so a memory-mapped file is used by the index without converting the data.
+ * The checksum covers everything after the header.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include "flat_array.h"
+#include "mapped_file.h"
+#include "status.h"
+
+/*!
+ * Ids of the sections of an index file
+ */
+enum class IndexSection : uint32_t {
+    TermArena = 1,      ///< characters of the terms
+    TermOffsets,        ///< offsets of the terms in the arena
+    TermHashes,         ///< hashes of the terms
+    TermSlots,          ///< hash table of the term ids
+    PostingTerms,       ///< TermInfo of every term
+    PostingBlocks,      ///< headers of the posting blocks
+    PostingDocBytes,    ///< encoded docId gaps
+    PostingCountBytes,  ///< encoded counts
+    Documents,          ///< number of documents and the files they were read from
+    PostingPositionOffsets, ///< offsets of the positions of the posting blocks, only in an index with positions
+    PostingPositionBytes    ///< encoded position gaps, only in an index with positions
+};
+
+/*!
+ * The header of an index file
+ */
+struct IndexFileHeader {
+    char magic[8];        //!< "EWFINDEX"
+    uint32_t version;     //!< version of the format
+    uint32_t sectionsNum; //!< number of records in the table of sections
+    uint64_t byteOrder;   //!< 0x0102030405060708 written in the byte order of the machine that saved the file
+    uint64_t checksum;    //!< checksum of the bytes following the header
+};
+
+/*!
+ * A record of the table of sections
+ */
+struct IndexSectionRecord {
+    uint32_t id;     //!< IndexSection value
+    uint32_t unused;
+    uint64_t offset; //!< offset of the section from the beginning of the file
+    uint64_t size;   //!< size of the section in bytes
+};
+
+/*!
+ * The file from which a document was read, used to find out whether a saved index is outdated
+ */
+struct DocumentSource {
+    std::string path;
+    uint64_t size = 0;     //!< size of the file in bytes
+    int64_t modified = -1; //!< time of the last modification, -1 if the file does not exist
+
+    bool operator ==(const DocumentSource &other) const {
+        return path == other.path && size == other.size && modified == other.modified;
+    }
+
+    bool operator !=(const DocumentSource &other) const { return !(*this == other); }
+};
+
+/*!
+ * Class for writing an index file
+ */
+class IndexFileWriter {
+public:
+    static const uint32_t version = 2; //!< version of the format written by this class
+
+/*!
+ * The method adds a section to the file. The data is not copied, it must stay valid until the file is written.
+ * @param [in] id id of the section
+ * @param [in] data the bytes of the section
+ * @param [in] size size of the section in bytes
+ */
+    void addSection(IndexSection id, const void *data, size_t size);
+
+    template<typename T, MemoryCategory category>
+    void addSection(IndexSection id, const FlatArray<T, category> &array) {
+        addSection(id, array.data(), array.size() * sizeof(T));
+    }
+
+/*!
+ * The method adds a section whose bytes are kept in a file, they are copied when the index file is written.
+ * This lets a section larger than the memory be written.
+ * @param [in] id id of the section
+ * @param [in] path path to the file holding the bytes of the section, it must exist until the index file is written
+ */
+    void addSection(IndexSection id, const std::string &path);
+
+/*!
+ * The method writes the file. The data is written to a temporary file which then replaces the old one,
+ * so the processes that have mapped the old file keep working with it.
+ * @param [in] path path to the index file
+ * @return operation status:
+ * OK - the file is written;
+ * ERROR - an error occurred while writing the file.
+ */
+    status write(const std::string &path) const;
+
+private:
+    struct PendingSection {
+        IndexSection id;
+        const void *data;
+        size_t size;
+        std::string path; //!< the file holding the bytes, if the section is not in memory
+    };
+
+    std::vector<PendingSection> sections;
+};
+
+/*!
+ * Class for reading an index file mapped into memory
+ */
+class IndexFileReader {
+public:
+/*!
+ * The method maps the file and checks its header and table of sections.
+ * @param [in] path path to the index file
+ * @param [in] verify whether the checksum of the whole file is checked, this reads every page of the file
+ * @return operation status:
+ * OK - the file is valid;
+ * ERROR - the file is missing, has another format version or is damaged.
+ */
+    status open(const std::string &path, bool verify);
+
+/*!
+ * The method finds a section.
+ * @param [in] id id of the section
+ * @param [out] data the bytes of the section
+ * @param [out] size size of the section in bytes
+ * @return true if the file has the section
+ */
+    bool findSection(IndexSection id, const char *&data, size_t &size) const;
+
+/*!
+ * The method makes the array refer to the elements stored in a section.
+ * @param [in] id id of the section
+ * @param [out] array the array
+ * @return true if the file has the section and its size is a multiple of the element size
+ */
+    template<typename T, MemoryCategory category>
+    bool attachSection(IndexSection id, FlatArray<T, category> &array) const {
+        const char *data;
+        size_t size;
+        if (!findSection(id, data, size) || size % sizeof(T) != 0)
+            return false;
+        array.attach((const T *) data, size / sizeof(T));
+        return true;
+    }
+
+/*!
+ * The method for getting the mapped file. The arrays attached to the sections are valid while the file is mapped.
+ * @return the mapped file
+ */
+    const std::shared_ptr<MappedFile> &getFile() const { return file; }
+
+private:
+    std::shared_ptr<MappedFile> file;
+    std::vector<IndexSectionRecord> sections;
+};
@@ -0,0 +1,72 @@
+/*!
+ * \file
+ * \brief Header file declaring the IndexRuns class
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "index_segment.h"
+#include "status.h"
+
+/*!
+ * \brief Sorted runs of postings written to disk when the postings of the base don't fit in memory
+ *
+ * Sorted runs of postings written to disk when the postings of the base don't fit in memory.
+ * The index is built in the single-pass in-memory way (SPIMI): a thread counts the postings in its partial
+ * dictionary until it fills its share of the memory budget, then writes them to a run file and starts anew.
+ * A run holds its terms in alphabetical order with the postings of every term sorted by docId, so all the
+ * runs are merged by reading them side by side, one term at a time, and only the dictionary of the index,
+ * the postings of one term and a read buffer per run are kept in memory.
+ * The run files are removed when the object is destroyed.
+ */
+class IndexRuns {
+public:
+/*!
+ * @param [in] inPathPrefix the prefix of the paths of the run files, a number is appended to it
+ */
+    explicit IndexRuns(const std::string &inPathPrefix);
+
+    IndexRuns(const IndexRuns &) = delete;
+
+    IndexRuns &operator =(const IndexRuns &) = delete;
+
+    ~IndexRuns();
+
+/*!
+ * The method writes the postings of a partial dictionary to a new run and frees the partial dictionary.
+ * It is called by several threads at once. A failed write is remembered and reported by merge.
+ * @param [in, out] partial the partial dictionary, it is emptied
+ * @return operation status:
+ * OK - the run is written;
+ * ERROR - an error occurred while writing the file.
+ */
+    status write(PartialDictionary &partial);
+
+/*!
+ * The method for getting the number of runs written.
+ * @return number of runs
+ */
+    size_t size() const;
+
+/*!
+ * The method merges the runs into an index file holding one segment. The file is the same as the one saved
+ * by an index built in memory from the same postings. The encoded postings are written to temporary files
+ * next to the index file while the runs are merged, and are then copied into it.
+ * @param [in] path path to the index file
+ * @param [in] documents bytes of the documents section
+ * @return operation status:
+ * OK - the file is written;
+ * ERROR - a run was not written or an error occurred while reading or writing the files.
+ */
+    status merge(const std::string &path, const std::vector<char> &documents);
+
+private:
+    std::string pathPrefix;
+    mutable std::mutex access;     //!< guards the list of runs
+    std::vector<std::string> paths; //!< paths of the run files in the order they were started
+    bool isFailed = false;         //!< whether a run could not be written
+};
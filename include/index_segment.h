@@ -0,0 +1,84 @@
+/*!
+ * \file
+ * \brief Header file declaring the IndexSegment structure
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "posting_arena.h"
+#include "mapped_file.h"
+
+/*!
+ * \brief Immutable part of the index built from a group of documents
+ *
+ * Immutable part of the index built from a group of documents.
+ * The postings of a segment use the ids of the documents in the whole base, so a document is scored
+ * by the segment that holds it without translating the ids. A segment is never changed after it is built:
+ * a removed or replaced document stays in its postings and is skipped by the search until the segment
+ * is merged with others.
+ */
+struct IndexSegment {
+    uint32_t id = 0;                   //!< id of the segment, unique within the index
+    std::vector<uint32_t> docIds;      //!< documents of the segment in increasing order
+    TermDictionary terms;              //!< interned terms, term ids are given out in alphabetical order
+    PostingStore postings;             //!< compressed postings indexed by term id
+    std::shared_ptr<MappedFile> file;  //!< the index file the arrays refer to, if the segment was loaded
+
+/*!
+ * The method for getting the compressed postings of a word without copying them.
+ * @param [in] word the word whose postings are requested
+ * @return view of the postings with the word statistics, empty if the word is not in the segment
+ */
+    PostingList getPostings(const std::string &word) const {
+        uint32_t termId = terms.find(word);
+        return termId == TermDictionary::npos ? PostingList() : postings.getPostings(termId);
+    }
+};
+
+/*!
+ * \brief Postings counted by one thread before they are merged into a segment
+ *
+ * Postings counted by one thread before they are merged into a segment.
+ * The postings of a term may be in any order and may hold several entries of one document,
+ * they are sorted and summed up by the merge. When the positions are indexed, the postings hold
+ * an occurrence per word instead, numbered within the block of text the word was read from (see BlockStart).
+ */
+struct PartialDictionary {
+    TermDictionary terms;
+    PostingArena postings; //!< postings indexed by the term id of the partial dictionary
+};
+
+/*!
+ * The place of a block of text in its document. The blocks of a document are tokenized by several threads
+ * at once, so the words of a block are numbered from 0 and get their positions in the document once the number
+ * of words of every block is known.
+ */
+struct BlockStart {
+    uint32_t docId;
+    uint32_t firstPosition; //!< position of the first word of the block in the document
+};
+
+/*!
+ * The function places the blocks of text in their documents.
+ * @param [in] docIds the document of every block, the blocks of a document are in their order in it
+ * @param [in] wordsNums the number of words of every block
+ * @return the place of every block
+ */
+inline std::vector<BlockStart> getBlockStarts(const std::vector<uint32_t> &docIds,
+                                              const std::vector<uint32_t> &wordsNums) {
+    std::vector<BlockStart> starts(docIds.size());
+    std::vector<uint32_t> docWords; ///< words of the blocks of every document seen so far
+    for (size_t block = 0; block < docIds.size(); block++) {
+        if (docWords.size() <= docIds[block])
+            docWords.resize(docIds[block] + 1, 0);
+        starts[block] = {docIds[block], docWords[docIds[block]]};
+        docWords[docIds[block]] += wordsNums[block];
+    }
+    return starts;
+}
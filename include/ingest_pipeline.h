@@ -0,0 +1,191 @@
+/*!
+ * \file
+ * \brief Header file declaring the IngestPipeline class
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include "bounded_queue.h"
+#include "inverted_index.h"
+#include "mapped_file.h"
+#include "term_dictionary.h"
+#include "text_view.h"
+
+/*!
+ * Settings of the ingestion pipeline, 0 means the default value
+ */
+struct IngestSettings {
+    size_t readers = 0;     //!< threads reading the files, 2 by default
+    size_t tokenizers = 0;  //!< threads splitting the text into words, half of the hardware threads by default
+    size_t indexers = 0;    //!< threads adding the words to the postings, half of the hardware threads by default
+    size_t queueDepth = 0;  //!< capacity of the queues between the stages, 16 blocks by default
+    size_t blockSize = 0;   //!< the size of the text blocks the files are cut into, 1 MB by default
+    size_t memoryBudget = 0; //!< bytes the postings of all the indexers may take before they go to runs on disk, 0 means no limit
+};
+
+/*!
+ * Statistics of one stage of the ingestion pipeline
+ */
+struct StageStats {
+    std::string name;
+    size_t threads = 0;
+    size_t blocks = 0;        //!< number of blocks processed by the stage
+    uint64_t bytes = 0;       //!< number of text bytes in the processed blocks
+    double busySeconds = 0;   //!< time the threads of the stage spent working, not waiting for the queues
+};
+
+/*!
+ * Statistics of a run of the ingestion pipeline
+ */
+struct IngestStats {
+    size_t docsAmount = 0;
+    double seconds = 0;             //!< the time of the whole run
+    std::vector<StageStats> stages; //!< read, tokenize and index stages
+    QueueStats readQueue;           //!< the queue from the readers to the tokenizers
+    QueueStats tokenQueue;          //!< the queue from the tokenizers to the indexers
+    size_t runsNum = 0;             //!< number of runs written to disk, 0 if the index was built in memory
+};
+
+/*!
+ * \brief Streaming ingestion of the document files into the index
+ *
+ * Streaming ingestion of the document files into the index.
+ * The files go through three stages connected by bounded queues:
+ * - the readers map the files, cut them into blocks at whitespace and start reading the pages of every block;
+ * - the tokenizers split a block into words and count them;
+ * - the indexers add the counted words of a block to their partial dictionaries.
+ * All the stages run at the same time, so reading the disk overlaps with the work of the processor, and only
+ * the blocks waiting in the queues are held in memory besides the postings. The stages wait for each other
+ * on the queues, so they run on their own threads rather than on the shared pool.
+ */
+class IngestPipeline {
+public:
+    explicit IngestPipeline(const IngestSettings &inSettings);
+
+/*!
+ * The method reads the files and fills the base of documents of the index. The files that can't be opened
+ * are skipped, the rest get docIds in the order of the list.
+ * @param [in] paths paths to the document files
+ * @param [out] index the index
+ */
+    void run(const std::vector<std::string> &paths, InvertedIndex &index);
+
+/*!
+ * \brief The method reads the files and builds the index in a file within the memory budget.
+ *
+ * The method reads the files and builds the index in a file within the memory budget.
+ * When the postings of an indexer take more than its share of settings.memoryBudget, they are written
+ * to a sorted run next to the index file and the indexer starts anew. At the end the runs are merged
+ * into the index file, which is loaded into the index (see InvertedIndex::updateDocumentBase with runs).
+ * The file is the same as the one saved after run, so the base may be larger than the memory.
+ * The lowercase flag and the sources of the index are saved in the file, so they are set before.
+ * The runs hold no positions, so an index with positions is built in memory and saved to the file.
+ * @param [in] paths paths to the document files
+ * @param [out] index the index
+ * @param [in] indexPath path to the index file
+ * @return operation status:
+ * OK - the index is built and loaded;
+ * ERROR - an error occurred while writing the runs or the index file.
+ */
+    status run(const std::vector<std::string> &paths, InvertedIndex &index, const std::string &indexPath);
+
+/*!
+ * The method for getting the statistics of the last run.
+ * @return the statistics
+ */
+    const IngestStats &getStats() const { return stats; }
+
+/*!
+ * The method prints the statistics of the last run: the throughput of every stage and the depths
+ * of the queues, the stage that keeps its input queue full is the one to give more threads.
+ * @param [out] out the stream
+ */
+    void printStats(std::ostream &out) const;
+
+private:
+/*!
+ * A block of a document file
+ */
+    struct TextBlock {
+        size_t docId;
+        uint32_t blockId;                 //!< number of the block in the run, the blocks of a file get increasing numbers
+        TextView text;
+        std::shared_ptr<MappedFile> file; //!< the block refers to the mapping, it is unmapped after the last block
+    };
+
+/*!
+ * The counted words of a block
+ */
+    struct TokenizedBlock {
+        size_t docId;
+        uint32_t blockId;
+        size_t bytes;
+        TermDictionary words;
+        std::vector<uint32_t> counts; //!< number of occurrences of every word, indexed by word id
+        std::vector<uint32_t> tokens; //!< word id of every word of the text in its order, only with positions
+    };
+
+/*!
+ * The number of words of a block, counted by the indexers to place the blocks in their documents
+ */
+    struct BlockWords {
+        uint32_t blockId;
+        uint32_t docId;
+        uint32_t wordsNum;
+    };
+
+    IngestSettings settings;
+    IngestStats stats;
+
+/*!
+ * The method runs the stages of the pipeline over the files.
+ * @param [in] paths paths to the document files
+ * @param [in] lowercase whether the words are turned to lowercase
+ * @param [in] positions whether the positions of the words are indexed, the runs must be nullptr then
+ * @param [out] partials postings of every indexer that are not written to runs
+ * @param [out] runs the runs the postings over the budget are written to, nullptr keeps all of them in memory
+ * @param [out] blockStarts with positions, the places of the blocks the occurrences of the partials are numbered in
+ */
+    void runStages(const std::vector<std::string> &paths, bool lowercase, bool positions,
+                   std::vector<PartialDictionary> &partials, IndexRuns *runs, std::vector<BlockStart> &blockStarts);
+
+/*!
+ * The method of a reader thread: it takes the files one by one and cuts them into blocks
+ * @param [in] files paths to the files that could be opened, indexed by docId
+ * @param [in, out] nextFile docId of the next file to be taken
+ * @param [in, out] nextBlock number of the next block of all the readers
+ * @param [out] blocks the queue to the tokenizers
+ * @param [out] stage statistics of the thread
+ */
+    void readFiles(const std::vector<std::string> &files, std::atomic<size_t> &nextFile,
+                   std::atomic<uint32_t> &nextBlock, BoundedQueue<TextBlock> &blocks, StageStats &stage) const;
+
+/*!
+ * The method of a tokenizer thread: it counts the words of the blocks
+ * @param [in] blocks the queue from the readers
+ * @param [out] tokenized the queue to the indexers
+ * @param [in] lowercase whether the words are turned to lowercase
+ * @param [in] positions whether the order of the words is kept
+ * @param [out] stage statistics of the thread
+ */
+    static void tokenizeBlocks(BoundedQueue<TextBlock> &blocks, BoundedQueue<TokenizedBlock> &tokenized,
+                               bool lowercase, bool positions, StageStats &stage);
+
+/*!
+ * The method of an indexer thread: it adds the counted words of the blocks to its partial dictionary
+ * @param [in] tokenized the queue from the tokenizers
+ * @param [out] partial partial dictionary of the thread
+ * @param [out] runs the runs the partial dictionary is written to when it takes more than the budget, may be nullptr
+ * @param [in] budget the bytes the partial dictionary may take
+ * @param [out] blockWords with positions, the number of words of every block of the thread
+ * @param [out] stage statistics of the thread
+ */
+    static void indexBlocks(BoundedQueue<TokenizedBlock> &tokenized, PartialDictionary &partial, IndexRuns *runs,
+                            size_t budget, std::vector<BlockWords> &blockWords, StageStats &stage);
+};
@@ -8,25 +8,61 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <map>
+#include <memory>
+#include <future>
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "index_segment.h"
+#include "index_file.h"
+#include "index_runs.h"
+#include "text_view.h"
+#include "status.h"
+#include "memory_accounting.h"
 
 /*!
- * A structure containing the field of the document's Id  and a count field 
- * corresponding to the number of occurrences of a specific word in this document
+ * A term with the number of documents containing it
  */
-struct Entry {
-    size_t docId, count;
-//!< This operator is required for test scenarios
-    bool operator ==(const Entry& other) const {
-        return (docId == other.docId &&
-                count == other.count);
-    }
+struct TermFrequency {
+    std::string term;
+    size_t docFrequency;
 };
 
+/*!
+ * Sizes and memory of an index
+ */
+struct IndexMemoryStats {
+    size_t docsAmount = 0;
+    size_t segmentsNum = 0;
+    size_t vocabularySize = 0;    //!< number of distinct terms in all the segments
+    size_t postingsNum = 0;       //!< number of postings of all the terms, one per term and document
+    uint64_t rawTextBytes = 0;    //!< size of the document files, the text is not kept by the index
+    MemoryUsage dictionary;       //!< the term dictionaries of the segments
+    MemoryUsage postings;         //!< the posting stores of the segments
+    MemoryUsage positions;        //!< the part of the posting stores taken by the positions of the words
+    MemoryUsage documents;        //!< the tables of the documents, the segments and the sources
+    std::vector<size_t> docFrequencyHistogram;  //!< the element i is the number of terms found in [2^i, 2^(i+1)) documents
+    std::vector<TermFrequency> longestPostings; //!< the terms found in the most documents, the longest first
+};
+
+/*!
+ * \brief Inverted index made of immutable segments
+ *
+ * Inverted index made of immutable segments.
+ * updateDocumentBase builds a single segment from all the documents. updateDocuments and removeDocuments
+ * change only the given documents: the new versions are indexed into a new segment and the old versions
+ * are marked as deleted (tombstones), so the cost of an update depends on the size of the change.
+ * Small segments are merged in the background, a merge also drops the deleted documents.
+ * Every document is live in at most one segment, so the search returns the same results as after a full rebuild.
+ * A copy of the index shares the segments, it costs only the table of the documents, so the next version
+ * of the index for SearchServer is prepared by copying and updating the current one.
+ */
 class InvertedIndex {
 public:
+    static const uint32_t npos = UINT32_MAX; //!< segment id of a document that is not in the index
+
     InvertedIndex();
 
 /*!
@@ -36,56 +72,343 @@ public:
     void updateDocumentBase(const std::vector<std::string>& inputDocs);
 
 /*!
-* The method determines the number of occurrences of the word in the loaded 
-* document base
+ * The method fills the base of documents on which the search is performed. The texts are only read
+ * while the method runs, so they may be kept in memory-mapped files that are closed afterwards.
+ * @param [in] inputDocs views of the document content
+ */
+    void updateDocumentBaseViews(const std::vector<TextView> &inputDocs);
+
+/*!
+ * The method fills the base of documents from the postings counted outside the index, for example by IngestPipeline.
+ * @param [in] partials postings of the documents [0, docsAmount), they are cleared
+ * @param [in] docsAmount number of documents
+ * @param [in] blockStarts the places of the blocks the occurrences of the partials are numbered in,
+ * required if the index has positions
+ */
+    void updateDocumentBase(std::vector<PartialDictionary> &partials, size_t docsAmount,
+                            const std::vector<BlockStart> *blockStarts = nullptr);
+
+/*!
+ * \brief The method fills the base of documents from runs of postings written to disk.
+ *
+ * The method fills the base of documents from runs of postings written to disk, for example by IngestPipeline
+ * when the postings don't fit in memory. The runs are merged into the index file, which is then loaded,
+ * so the index is mapped and the base may be larger than the memory. The file is the same as the one
+ * saved after building the index in memory. The lowercase flag and the sources are saved in the file,
+ * so they are set before.
+ * @param [in] runs postings of the documents [0, docsAmount)
+ * @param [in] docsAmount number of documents
+ * @param [in] path path to the index file
+ * @return operation status:
+ * OK - the index is written and loaded;
+ * ERROR - an error occurred while merging the runs or writing the file, the index is left unchanged.
+ */
+    status updateDocumentBase(IndexRuns &runs, size_t docsAmount, const std::string &path);
+
+/*!
+ * The method adds documents to the index or replaces the documents with the same ids.
+ * @param [in] docIds ids of the documents, docIds[i] gets the content inputDocs[i]
+ * @param [in] inputDocs document content
+ */
+    void updateDocuments(const std::vector<size_t> &docIds, const std::vector<std::string> &inputDocs);
+
+/*!
+ * The method adds documents to the index or replaces the documents with the same ids.
+ * @param [in] docIds ids of the documents, docIds[i] gets the content inputDocs[i]
+ * @param [in] inputDocs views of the document content, they are only read while the method runs
+ */
+    void updateDocumentViews(const std::vector<size_t> &docIds, const std::vector<TextView> &inputDocs);
+
+/*!
+ * The method removes documents from the index. Ids of the documents that are not in the index are ignored.
+ * @param [in] docIds ids of the documents
+ */
+    void removeDocuments(const std::vector<size_t> &docIds);
+
+/*!
+ * The method waits until the background merges are finished and their segments are used by the index.
+ */
+    void waitForMerges();
+
+/*!
+* The method determines the number of occurrences of the word in the loaded
+* document base. The postings are decoded into a new list, the search uses the segments instead.
 * @param [in] word the word whose occurrence frequency is to be determined
 * @return prepared list with word frequency
 */
     std::vector<Entry> getWordCount(const std::string &word);
 
 /*!
- * The method for getting a frequency dictionary.
- * @return frequency dictionary
+ * The method for getting the number of segments.
+ * @return number of segments
+ */
+    size_t getSegmentsNum() const { return segments.size(); }
+
+/*!
+ * The method for getting a segment.
+ * @param [in] i index of the segment, less than getSegmentsNum()
+ * @return the segment
+ */
+    const IndexSegment &getSegment(size_t i) const { return *segments[i].segment; }
+
+/*!
+ * The method determines whether some documents of a segment were removed or replaced.
+ * @param [in] i index of the segment, less than getSegmentsNum()
+ * @return true if the segment has documents that must be skipped
+ */
+    bool hasDeletedDocs(size_t i) const { return segments[i].deletedNum != 0; }
+
+/*!
+ * The method determines whether a document of a segment is live, that is neither removed nor replaced.
+ * @param [in] i index of the segment, less than getSegmentsNum()
+ * @param [in] docId id of a document of the segment
+ * @return true if the segment holds the current version of the document
  */
-    std::map<std::string, std::vector<Entry>> getFreqDictionary();
+    bool isLive(size_t i, uint32_t docId) const { return docSegments[docId] == segments[i].segment->id; }
 
 /*!
  * The method for getting the number of documents to search.
- * @return number of documents to search.
+ * @return number of documents to search, one more than the highest document id
+ */
+    size_t getDocsAmount() const;
+
+/*!
+ * The method sets whether the ASCII letters of the words are turned to lowercase, so that "Great" and "great"
+ * are one term. The documents indexed before keep their words, so the flag is set before the base is filled.
+ * The flag is saved with the index, and the search turns the words of the queries to lowercase too.
+ * @param [in] inLowercase whether the words are turned to lowercase
+ */
+    void setLowercase(bool inLowercase) { lowercase = inLowercase; }
+
+/*!
+ * The method determines whether the words of the documents are turned to lowercase.
+ * @return true if the words are turned to lowercase
+ */
+    bool isLowercase() const { return lowercase; }
+
+/*!
+ * The method sets whether the positions of the words in the documents are indexed, they are needed
+ * to search for phrases. Like the lowercase flag it is set before the base is filled and saved with the index.
+ * @param [in] inPositions whether the positions are indexed
+ */
+    void setPositions(bool inPositions) { positions = inPositions; }
+
+/*!
+ * The method determines whether the positions of the words in the documents are indexed.
+ * @return true if the segments have positions
+ */
+    bool hasPositions() const { return positions; }
+
+/*!
+ * The method remembers the files the documents were read from, they are saved with the index.
+ * @param [in] inSources the files in the order of the documents
+ */
+    void setSources(const std::vector<DocumentSource> &inSources);
+
+/*!
+ * The method for getting the files the documents were read from.
+ * @return the files in the order of the documents
+ */
+    const std::vector<DocumentSource> &getSources() const;
+
+/*!
+ * \brief The method measures the index.
+ *
+ * The method measures the index. The memory of the dictionaries and the postings is the capacity
+ * of their arrays, exactly what was requested from the heap, and the part of a loaded index that stays
+ * in the mapped file is reported separately. A segment shared with another copy of the index is counted
+ * in both copies. The document frequencies of a term in several segments are summed up, the postings
+ * of the deleted documents are counted until the segments are merged.
+ * @param [in] longestNum number of the longest postings lists to report
+ * @return the statistics
+ */
+    IndexMemoryStats getMemoryStats(size_t longestNum = 10) const;
+
+/*!
+ * The method saves the index to a binary file. The segments are merged into one in the file.
+ * @param [in] path path to the index file
+ * @return operation status:
+ * OK - the index is saved;
+ * ERROR - an error occurred while writing the file.
+ */
+    status save(const std::string &path) const;
+
+/*!
+ * \brief The method loads the index from a binary file.
+ *
+ * The method loads the index from a binary file.
+ * The file is mapped into memory and searched in place, so the loading time does not depend on the size
+ * of the index, the pages are read by the operating system when the search touches them.
+ * The index is left unchanged if the file can't be loaded.
+ * @param [in] path path to the index file
+ * @param [in] verify whether the checksum of the whole file is checked before it is used
+ * @return operation status:
+ * OK - the index is loaded;
+ * ERROR - the file is missing, has another format version or is damaged.
+ */
+    status load(const std::string &path, bool verify = false);
+
+/*!
+ * A part of one document [begin, end) processed by one thread at a time
  */
-    size_t getDocsAmount();
+    struct TextChunk {
+        size_t docId;
+        size_t begin, end;
+        uint32_t wordsNum;  //!< number of words of the chunk, counted when the positions are indexed
+    };
+
+/*!
+ * \brief The method cuts the documents into chunks of about the given size.
+ *
+ * The method cuts the documents into chunks of about the given size.
+ * This method is necessary for the even distribution of the work among threads: a large document is
+ * processed by several threads, while small documents are taken one by one by the threads that are free.
+ * A chunk never cuts a word, it ends at the first whitespace after the given size.
+ * @param [in] inputDocs document content
+ * @param [in] chunkSize the size of a chunk in bytes
+ * @return chunks of all the documents in increasing order of docId and position
+ */
+    static std::vector<TextChunk> getChunks(const std::vector<TextView> &inputDocs, size_t chunkSize);
 
 private:
+/*!
+ * A segment used by the index
+ */
+    struct SegmentSlot {
+        std::shared_ptr<const IndexSegment> segment;
+        size_t deletedNum; //!< number of documents of the segment that were removed or replaced
+    };
+
+/*!
+ * A merge running in the background
+ */
+    struct PendingMerge {
+        std::vector<uint32_t> sourceIds; //!< ids of the merged segments
+        std::shared_future<std::shared_ptr<const IndexSegment>> result;
+    };
+
+    std::vector<SegmentSlot> segments;    //!< segments of the index
+    std::vector<uint32_t> docSegments;    //!< docId -> id of the segment with the live version of the document, or npos
+    uint32_t nextSegmentId = 0;
+    std::shared_ptr<PendingMerge> merge;  //!< the merge in progress, if any
+    std::vector<DocumentSource> sources;  //!< files the documents were read from
+    bool lowercase = false;               //!< whether the words are turned to lowercase
+    bool positions = false;               //!< whether the positions of the words are indexed
+
+    static const size_t mergeFactor = 4;  //!< number of segments of similar size that are merged into one
+
+    static const size_t minChunkSize = 64 * 1024;  //!< documents smaller than this are never split
+    static const size_t chunksPerThread = 8;       //!< how many chunks the text is cut into per thread
+
+/*!
+ * The method indexes documents into a new segment using the threads of the shared pool
+ * @param [in] docIds ids of the documents in increasing order
+ * @param [in] inputDocs document content, inputDocs[i] is the content of docIds[i]
+ * @param [in] lowercase whether the words are turned to lowercase
+ * @param [in] positions whether the positions of the words are indexed
+ * @return the segment, its id is set by the caller
+ */
+    static std::shared_ptr<IndexSegment> buildSegment(const std::vector<uint32_t> &docIds,
+                                                      const std::vector<TextView> &inputDocs, bool lowercase,
+                                                      bool positions);
+
+/*!
+ * The method makes a segment holding the documents [0, n) the only segment of the index
+ * @param [in] segment the segment
+ */
+    void replaceSegments(std::shared_ptr<IndexSegment> segment);
+
+/*!
+ * The method merges segments into a new one, the documents that are not live are dropped
+ * @param [in] sources the merged segments
+ * @param [in] liveDocs ids of the live documents of every merged segment in increasing order
+ * @param [in] segmentId id of the new segment
+ * @return the segment, it has positions if the merged segments have them
+ */
+    static std::shared_ptr<IndexSegment> mergeSegments(const std::vector<std::shared_ptr<const IndexSegment>> &sources,
+                                                       const std::vector<std::vector<uint32_t>> &liveDocs,
+                                                       uint32_t segmentId);
 
-    std::vector<std::string> docs; //!< document content list
-    std::map<std::string, std::vector<Entry>> freqDictionary; //!< frequency dictionary
+/*!
+ * The method adds a segment to the index, the documents of the segment replace their older versions
+ * @param [in] segment the segment
+ */
+    void addSegment(std::shared_ptr<const IndexSegment> segment);
 
 /*!
- * The method of filling the frequency dictionary with words from the documents 
- * that are being searched
+ * The method marks a document as deleted in the segment that holds it
+ * @param [in] docId id of the document
  */
-    void fillDictionaryByWords();
+    void deleteDocument(uint32_t docId);
 
-    /*!
-     * The method for getting the number of occurrences of a word in a text.
-     * @param [in] text word search test
-     * @param [in] word the word to be searched for in the text
-     * @return the number of occurrences of the word in the text
-     */
-    static size_t getCount(const std::string &text, const std::string &word);
+/*!
+ * The method for getting the ids of the live documents of a segment.
+ * @param [in] slot the segment
+ * @return ids of the documents in increasing order
+ */
+    std::vector<uint32_t> getLiveDocs(const SegmentSlot &slot) const;
 
 /*!
- * \brief The method groups the specified number of elements into the specified number 
- * of groups.
+ * \brief The method starts a background merge if the segments need one.
  *
- * The method groups the specified number of elements into the specified number of groups.
- * This method is necessary for the optimal distribution of processed documents into threads.
- * For example, with the input data amount = 7, groups = 3, we get the result
- * {{0, 3, 6}, {1, 4}, {2, 5}}.
- * @param [in] amount the number of elements to be divided into groups
- * @param [in] groups the number of groups
- * @return vector of vectors of grouped element numbers
- */
-    static std::vector<std::vector<size_t>> getGroupsOfElements(size_t amount, int groups);
+ * The method starts a background merge if the segments need one.
+ * Segments are grouped by size in powers of mergeFactor, and mergeFactor segments of one group are merged.
+ * A segment with more deleted than live documents is rewritten alone. Every document is therefore
+ * merged about log(size of the base) times, which keeps the cost of the updates proportional to their size.
+ * Only one merge runs at a time.
+ */
+    void scheduleMerge();
+
+/*!
+ * The method replaces the merged segments with the result of the background merge if it is ready
+ * @param [in] wait whether to wait for the merge to finish
+ */
+    void finishMerge(bool wait);
+
+/*!
+ * The method splits one chunk into words and counts them in the partial dictionary of the calling thread.
+ * The words are interned straight from the text, no string is created for a word.
+ * With positions every word is added as an occurrence numbered within the chunk, the chunk is its block.
+ * @param [in] inputDocs document content
+ * @param [in] docIds ids of the documents
+ * @param [in] chunkId the number of the chunk
+ * @param [in, out] chunk the chunk to be processed, chunks must be processed in increasing order;
+ * with positions its number of words is set
+ * @param [in] lowercase whether the words are turned to lowercase
+ * @param [in] positions whether the positions of the words are indexed
+ * @param [out] partial partial dictionary of the calling thread
+ */
+    static void fillPartialDictionary(const std::vector<TextView> &inputDocs, const std::vector<uint32_t> &docIds,
+                                      uint32_t chunkId, TextChunk &chunk, bool lowercase, bool positions,
+                                      PartialDictionary &partial);
+
+/*!
+ * The method merges the partial dictionaries into the postings of a segment.
+ * Postings of every word are sorted by docId, terms get ids in alphabetical order, so the index
+ * does not depend on the scheduling of the threads.
+ * @param [in] partials partial dictionaries, they are cleared during the merge
+ * @param [in] positions whether the partials hold occurrences
+ * @param [in] blockStarts the places of the blocks the occurrences are numbered in, nullptr if the occurrences
+ * hold the docIds and the positions in the documents
+ * @param [out] segment the segment whose terms and postings are filled
+ */
+    static void mergePartialDictionaries(std::vector<PartialDictionary> &partials, bool positions,
+                                         const std::vector<BlockStart> *blockStarts, IndexSegment &segment);
+
+/*!
+ * The method encodes the number of documents, the lowercase and positions flags and the sources for the index file.
+ * @param [in] docsAmount number of documents
+ * @return bytes of the documents section
+ */
+    std::vector<char> encodeDocuments(size_t docsAmount) const;
+
+/*!
+ * The method decodes the documents section of the index file.
+ * @param [in] data bytes of the section
+ * @param [in] size size of the section
+ * @param [out] docsAmount number of documents
+ * @return true if the section is well-formed
+ */
+    bool decodeDocuments(const char *data, size_t size, size_t &docsAmount);
 };
 
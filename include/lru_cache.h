@@ -0,0 +1,209 @@
+/*!
+ * \file
+ * \brief Header file describing the LruCache template class
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+ * Statistics of a cache
+ */
+struct CacheStats {
+    size_t capacity = 0;    //!< the highest number of items the cache holds
+    size_t size = 0;        //!< number of items in the cache
+    uint64_t hits = 0;      //!< number of lookups that found an item
+    uint64_t misses = 0;    //!< number of lookups that found nothing
+    uint64_t evictions = 0; //!< number of items dropped to make room for new ones
+
+/*!
+ * The method for getting the share of the lookups that found an item.
+ * @return the hit rate from 0 to 1, 0 if there were no lookups
+ */
+    double getHitRate() const { return hits + misses != 0 ? (double) hits / (double) (hits + misses) : 0; }
+};
+
+/*!
+ * \brief Cache of a bounded size that drops the least recently used items
+ *
+ * Cache of a bounded size that drops the least recently used items.
+ * The keys are spread over shards by their hash, every shard is a list in the order of use with its own mutex,
+ * so the threads looking up different keys rarely wait for each other. The capacity is split among the shards,
+ * a cache smaller than the number of shards uses one shard per item.
+ * Every item has the version of the data it was made from, an item of another version is never returned.
+ * @tparam Value type of the items
+ */
+template<typename Value>
+class LruCache {
+public:
+/*!
+ * @param [in] inCapacity the highest number of items the cache holds, 0 disables the cache
+ */
+    explicit LruCache(size_t inCapacity = 0) : shards(shardsNum) {
+        setCapacity(inCapacity);
+    }
+
+/*!
+ * The method changes the capacity of the cache, the least recently used items over the capacity are dropped.
+ * A capacity that changes the number of shards in use drops all the items.
+ * @param [in] inCapacity the highest number of items the cache holds, 0 disables the cache
+ */
+    void setCapacity(size_t inCapacity) {
+        std::lock_guard<std::mutex> capacityLock(capacityAccess);
+        if (inCapacity == capacity)
+            return;
+        capacity = inCapacity;
+        size_t newShardsUsed = std::max<size_t>(std::min(inCapacity, shardsNum), 1);
+        ///< The keys move to other shards, the items left in the old ones could never be found
+        bool moved = newShardsUsed != shardsUsed;
+        shardsUsed = newShardsUsed;
+        for (size_t i = 0; i < shardsNum; i++) {
+            Shard &shard = shards[i];
+            std::lock_guard<std::mutex> lock(shard.access);
+            ///< The shards get equal parts of the capacity, the rest goes to the first ones one by one
+            shard.capacity = i < newShardsUsed ? inCapacity / newShardsUsed + (i < inCapacity % newShardsUsed) : 0;
+            if (moved) {
+                shard.items.clear();
+                shard.positions.clear();
+            }
+            while (shard.items.size() > shard.capacity)
+                evict(shard);
+        }
+    }
+
+/*!
+ * The method looks up an item and marks it as the most recently used.
+ * @param [in] key the key
+ * @param [out] value copy of the item
+ * @param [in] version the version the item must have, an item of another version is dropped
+ * @return true if the item was found, a lookup that found nothing or an item of another version is a miss
+ */
+    bool get(const std::string &key, Value &value, uint64_t version = 0) {
+        Shard &shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.access);
+        auto found = shard.positions.find(key);
+        if (found == shard.positions.end()) {
+            shard.misses++;
+            return false;
+        }
+        if (found->second->version != version) {
+            shard.items.erase(found->second);
+            shard.positions.erase(found);
+            shard.misses++;
+            return false;
+        }
+        shard.items.splice(shard.items.begin(), shard.items, found->second);
+        value = found->second->value;
+        shard.hits++;
+        return true;
+    }
+
+/*!
+ * The method adds an item or replaces the item with the same key, the least recently used item is dropped
+ * if the cache is full.
+ * @param [in] key the key
+ * @param [in] value the item
+ * @param [in] version the version of the data the item was made from
+ */
+    void put(const std::string &key, Value value, uint64_t version = 0) {
+        Shard &shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.access);
+        if (shard.capacity == 0)
+            return;
+        auto found = shard.positions.find(key);
+        if (found != shard.positions.end()) {
+            found->second->version = version;
+            found->second->value = std::move(value);
+            shard.items.splice(shard.items.begin(), shard.items, found->second);
+            return;
+        }
+        if (shard.items.size() >= shard.capacity)
+            evict(shard);
+        shard.items.push_front({key, version, std::move(value)});
+        shard.positions.emplace(key, shard.items.begin());
+    }
+
+/*!
+ * The method removes all the items, the statistics are kept.
+ */
+    void clear() {
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.access);
+            shard.items.clear();
+            shard.positions.clear();
+        }
+    }
+
+/*!
+ * The method for getting the statistics of the cache.
+ * @return the statistics
+ */
+    CacheStats getStats() {
+        CacheStats stats;
+        {
+            std::lock_guard<std::mutex> capacityLock(capacityAccess);
+            stats.capacity = capacity;
+        }
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.access);
+            stats.size += shard.items.size();
+            stats.hits += shard.hits;
+            stats.misses += shard.misses;
+            stats.evictions += shard.evictions;
+        }
+        return stats;
+    }
+
+private:
+/*!
+ * An item with its key and version
+ */
+    struct Item {
+        std::string key;
+        uint64_t version;
+        Value value;
+    };
+
+    typedef std::list<Item> item_list_t;
+
+/*!
+ * A part of the cache with its own lock
+ */
+    struct Shard {
+        std::mutex access;
+        size_t capacity = 0;
+        item_list_t items; //!< the most recently used item first
+        std::unordered_map<std::string, typename item_list_t::iterator> positions;
+        uint64_t hits = 0, misses = 0, evictions = 0;
+    };
+
+    static const size_t shardsNum = 16;
+
+    std::vector<Shard> shards;
+    std::atomic<size_t> shardsUsed{shardsNum}; //!< the keys are spread over the first shards only
+    size_t capacity = 0;
+    std::mutex capacityAccess;
+
+    Shard &getShard(const std::string &key) {
+        return shards[std::hash<std::string>()(key) % shardsUsed];
+    }
+
+    static void evict(Shard &shard) {
+        shard.positions.erase(shard.items.back().key);
+        shard.items.pop_back();
+        shard.evictions++;
+    }
+};
+
+template<typename Value>
+const size_t LruCache<Value>::shardsNum;
@@ -0,0 +1,60 @@
+/*!
+ * \file
+ * \brief Header file declaring the MappedFile class
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "status.h"
+
+/*!
+ * \brief Read-only memory mapping of a whole file
+ *
+ * Read-only memory mapping of a whole file.
+ * The pages are loaded by the operating system on first access and are shared through the page cache
+ * by all the processes that map the same file.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+/*!
+ * The method maps a file into memory.
+ * @param [in] path path to the file
+ * @return operation status:
+ * OK - the file is mapped;
+ * ERROR - the file can't be opened or mapped.
+ */
+    status open(const std::string &path);
+
+/*!
+ * The method unmaps the file.
+ */
+    void close();
+
+/*!
+ * The method asks the operating system to start reading a range of the file into memory,
+ * so the pages are loaded before they are first accessed. It does nothing where it is not supported.
+ * @param [in] offset the first byte of the range
+ * @param [in] size the number of bytes of the range
+ */
+    void willNeed(size_t offset, size_t size) const;
+
+    const char *data() const { return begin; }
+
+    size_t size() const { return length; }
+
+private:
+    const char *begin = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *mapping = nullptr; //!< handle of the file mapping object
+#endif
+};
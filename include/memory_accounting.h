@@ -0,0 +1,113 @@
+/*!
+ * \file
+ * \brief Header file declaring the MemoryAccounting class and the CountingAllocator template class
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+/*!
+ * The structures whose memory is counted
+ */
+enum class MemoryCategory {
+    Dictionary,  ///< the arrays of the term dictionaries
+    Postings,    ///< the arrays of the posting stores
+    Build,       ///< the postings collected by the threads while a segment is built
+    Count
+};
+
+/*!
+ * Memory used by a structure
+ */
+struct MemoryUsage {
+    size_t allocated = 0;  //!< bytes allocated on the heap, including the unused capacity
+    size_t mapped = 0;     //!< bytes referred to in a memory-mapped index file
+
+    MemoryUsage &operator +=(const MemoryUsage &other) {
+        allocated += other.allocated;
+        mapped += other.mapped;
+        return *this;
+    }
+};
+
+/*!
+ * \brief Process-wide counters of the bytes allocated for every category
+ *
+ * Process-wide counters of the bytes allocated for every category.
+ * The counters are updated by CountingAllocator, so they hold what was really requested from the heap
+ * by all the indexes, snapshots and merges alive in the process.
+ */
+class MemoryAccounting {
+public:
+/*!
+ * The method for getting the bytes allocated for a category now.
+ * @param [in] category the category
+ * @return the bytes
+ */
+    static size_t getAllocatedBytes(MemoryCategory category);
+
+/*!
+ * The method for getting the highest number of bytes allocated for a category at once.
+ * @param [in] category the category
+ * @return the bytes
+ */
+    static size_t getPeakBytes(MemoryCategory category);
+
+/*!
+ * The method for getting the name of a category.
+ * @param [in] category the category
+ * @return the name
+ */
+    static const char *getName(MemoryCategory category);
+
+/*!
+ * The methods count the bytes allocated and freed by CountingAllocator.
+ * @param [in] category the category
+ * @param [in] bytes the bytes
+ */
+    static void allocated(MemoryCategory category, size_t bytes);
+
+    static void deallocated(MemoryCategory category, size_t bytes);
+};
+
+/*!
+ * \brief Allocator that counts the bytes it allocates in MemoryAccounting
+ *
+ * Allocator that counts the bytes it allocates in MemoryAccounting.
+ * The memory is taken from std::allocator, the allocator has no state.
+ * @tparam T type of the elements
+ * @tparam category the category the bytes are counted in
+ */
+template<typename T, MemoryCategory category>
+struct CountingAllocator {
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind {
+        typedef CountingAllocator<U, category> other;
+    };
+
+    CountingAllocator() = default;
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U, category> &) {}
+
+    T *allocate(size_t n) {
+        T *result = std::allocator<T>().allocate(n);
+        MemoryAccounting::allocated(category, n * sizeof(T));
+        return result;
+    }
+
+    void deallocate(T *p, size_t n) {
+        MemoryAccounting::deallocated(category, n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator ==(const CountingAllocator<U, category> &) const { return true; }
+
+    template<typename U>
+    bool operator !=(const CountingAllocator<U, category> &) const { return false; }
+};
@@ -0,0 +1,181 @@
+/*!
+ * \file
+ * \brief Header file declaring the Metrics class and the macros of the instrumentation
+ *
+ * Header file declaring the Metrics class and the macros of the instrumentation.
+ * The macros are compiled out unless SEARCH_ENGINE_METRICS is defined, which is done by the
+ * SEARCH_ENGINE_METRICS option of CMake.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "status.h"
+
+/*!
+ * The timed parts of the work
+ */
+enum class MetricStage {
+    ReadBlock,     ///< reading a block of a document file
+    Index,         ///< building the index from the files
+    Merge,         ///< merging segments of the index
+    SaveIndex,     ///< saving the index file
+    LoadIndex,     ///< loading the index file
+    SearchBatch,   ///< searching a batch of requests
+    Query,         ///< searching one request
+    WriteAnswers,  ///< writing the answers
+    Count
+};
+
+/*!
+ * The counted events
+ */
+enum class MetricCounter {
+    PostingsScanned,  ///< postings read or sought by the search
+    DocumentsScored,  ///< documents whose relevance was calculated
+    BytesRead,        ///< bytes of the document files read
+    Count
+};
+
+/*!
+ * Timings of one stage
+ */
+struct StageMetrics {
+    static const size_t bucketsNum = 32;  //!< the bucket i holds the durations below 2^i microseconds, the last one the rest
+
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;             //!< the total duration
+    uint64_t buckets[bucketsNum] = {};    //!< the histogram of the durations
+};
+
+/*!
+ * Busy time of one worker thread
+ */
+struct ThreadMetrics {
+    size_t thread = 0;            //!< number of the thread in the order the threads first recorded a metric
+    double busySeconds = 0;       //!< the time spent running the tasks
+    double aliveSeconds = 0;      //!< the time from the first metric of the thread to its end or to now
+};
+
+/*!
+ * The metrics of all the threads summed up
+ */
+struct MetricsSnapshot {
+    double uptimeSeconds = 0;
+    std::vector<StageMetrics> stages;      //!< indexed by MetricStage
+    std::vector<uint64_t> counters;        //!< indexed by MetricCounter
+    std::vector<ThreadMetrics> threads;    //!< the threads of the pool and of the ingestion that did some work
+};
+
+/*!
+ * \brief Per-thread timers, histograms and counters of the hot paths
+ *
+ * Per-thread timers, histograms and counters of the hot paths.
+ * Every thread adds to its own block of counters, so recording a metric takes no lock and no atomic
+ * read-modify-write: the owner thread is the only writer and the readers sum up the blocks of all the threads.
+ * The blocks of the finished threads are kept, so the totals include them.
+ */
+class Metrics {
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+/*!
+ * The method for checking whether the metrics are compiled in.
+ * @return true if SEARCH_ENGINE_METRICS is defined
+ */
+    static bool isEnabled();
+
+/*!
+ * The method records one call of a stage.
+ * @param [in] stage the stage
+ * @param [in] nanoseconds duration of the call
+ */
+    static void addTime(MetricStage stage, uint64_t nanoseconds);
+
+/*!
+ * The method adds to a counter.
+ * @param [in] counter the counter
+ * @param [in] value the value added
+ */
+    static void add(MetricCounter counter, uint64_t value);
+
+/*!
+ * The method records the time the current thread spent working, not waiting for work.
+ * @param [in] nanoseconds the time
+ */
+    static void addBusyTime(uint64_t nanoseconds);
+
+/*!
+ * The method sums up the metrics of all the threads.
+ * @return the metrics
+ */
+    static MetricsSnapshot collect();
+
+/*!
+ * The method for getting the metrics in the text format of Prometheus.
+ * @return the text
+ */
+    static std::string getPrometheusText();
+
+/*!
+ * The method for getting the metrics as a JSON object.
+ * @return the object
+ */
+    static nlohmann::json getJson();
+
+/*!
+ * The method writes the metrics to a file, in JSON if the path ends with .json and in the text format
+ * of Prometheus otherwise.
+ * @param [in] path the path to the file
+ * @return operation status:
+ * OK - the file is written;
+ * ERROR - the file can't be written.
+ */
+    static status writeFile(const std::string &path);
+};
+
+/*!
+ * Timer adding the time from its construction to its destruction to a stage
+ */
+class StageTimer {
+public:
+    explicit StageTimer(MetricStage inStage) : stage(inStage), start(Metrics::clock_type::now()) {}
+
+    ~StageTimer() {
+        Metrics::addTime(stage, (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Metrics::clock_type::now() - start).count());
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    MetricStage stage;
+    Metrics::clock_type::time_point start;
+};
+
+#define METRICS_CONCAT_IMPL(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_IMPL(a, b)
+
+#ifdef SEARCH_ENGINE_METRICS
+/// Times the rest of the enclosing scope
+#define METRICS_TIME(stage) StageTimer METRICS_CONCAT(stageTimer, __LINE__)(stage)
+/// Records a call of the stage that took the duration
+#define METRICS_ADD_TIME(stage, duration) \
+    Metrics::addTime(stage, (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count())
+/// Adds the duration to the busy time of the current thread
+#define METRICS_ADD_BUSY_TIME(duration) \
+    Metrics::addBusyTime((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count())
+/// Adds the value to the counter
+#define METRICS_ADD(counter, value) Metrics::add(counter, value)
+#else
+#define METRICS_TIME(stage) ((void) 0)
+#define METRICS_ADD_TIME(stage, duration) ((void) 0)
+#define METRICS_ADD_BUSY_TIME(duration) ((void) 0)
+#define METRICS_ADD(counter, value) ((void) (value))
+#endif
@@ -0,0 +1,119 @@
+/*!
+ * \file
+ * \brief Header file declaring the PostingArena class
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "memory_accounting.h"
+#include "posting_list.h"
+
+/*!
+ * \brief Postings of many terms collected in large pages owned by one thread
+ *
+ * Postings of many terms collected in large pages owned by one thread.
+ * The postings of a term are a list of chunks taken from the pages by bumping an offset, every chunk
+ * of a term is twice as large as the previous one up to maxChunkEntries, so a rare term takes a few words
+ * and a frequent term takes a few chunks. Nothing is freed until the arena is cleared, then all the pages
+ * are freed at once. The pages are counted in the Build category of MemoryAccounting.
+ */
+class PostingArena {
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+/*!
+ * The method adds occurrences of a term in a document. If the last posting of the term is of the same
+ * document, the occurrences are added to it.
+ * @param [in] termId id of the term, at most the number of terms of the arena
+ * @param [in] docId id of the document
+ * @param [in] count number of occurrences
+ */
+    void add(uint32_t termId, uint32_t docId, uint32_t count);
+
+/*!
+ * The method adds an occurrence of a term, every occurrence is kept. The postings of an arena
+ * are either counts added by add or occurrences added by addOccurrence.
+ * @param [in] termId id of the term, at most the number of terms of the arena
+ * @param [in] occurrence the document and the position of the word
+ */
+    void addOccurrence(uint32_t termId, Occurrence occurrence);
+
+/*!
+ * The method for getting the number of terms.
+ * @return one more than the highest term id added
+ */
+    size_t size() const { return lists.size(); }
+
+/*!
+ * The method for getting the memory used by the arena.
+ * @return the memory of the pages and the lists of chunks
+ */
+    MemoryUsage getMemoryUsage() const {
+        MemoryUsage usage;
+        usage.allocated = pages.size() * pageWords * sizeof(uint32_t) + lists.capacity() * sizeof(TermList);
+        return usage;
+    }
+
+/*!
+ * The method appends the postings of a term to a vector in the order they were added.
+ * @param [in] termId id of the term
+ * @param [in, out] entries the vector
+ */
+    void appendTo(uint32_t termId, std::vector<Entry> &entries) const;
+
+/*!
+ * The method appends the occurrences of a term to a vector in the order they were added.
+ * @param [in] termId id of the term
+ * @param [in, out] occurrences the vector
+ */
+    void appendTo(uint32_t termId, std::vector<Occurrence> &occurrences) const;
+
+/*!
+ * The method frees all the pages.
+ */
+    void clear();
+
+private:
+    static const size_t pageWords = 1 << 16;      //!< size of a page in 32-bit words
+    static const uint32_t firstChunkEntries = 2;
+    static const uint32_t maxChunkEntries = 256;
+    static const uint32_t headerWords = 3;        //!< a chunk starts with the next chunk, the capacity and the used entries
+
+    typedef std::vector<uint32_t, CountingAllocator<uint32_t, MemoryCategory::Build>> page_t;
+
+/*!
+ * The chunks of one term, a chunk is addressed by its page and offset as page * pageWords + offset
+ */
+    struct TermList {
+        uint32_t head;
+        uint32_t tail;
+        uint32_t lastDocId;
+    };
+
+    std::vector<page_t> pages;
+    std::vector<TermList, CountingAllocator<TermList, MemoryCategory::Build>> lists;
+    size_t pageUsed = pageWords;                  //!< words used in the last page
+
+    uint32_t *getChunk(uint32_t address) { return pages[address / pageWords].data() + address % pageWords; }
+
+    const uint32_t *getChunk(uint32_t address) const {
+        return pages[address / pageWords].data() + address % pageWords;
+    }
+
+/*!
+ * The method adds a pair of words to the postings of a term.
+ * @param [in] termId id of the term
+ * @param [in] first the first word, the docId
+ * @param [in] second the second word
+ */
+    void addPair(uint32_t termId, uint32_t first, uint32_t second);
+
+/*!
+ * The method takes a new chunk from the pages.
+ * @param [in] capacity number of entries of the chunk
+ * @return address of the chunk
+ */
+    uint32_t newChunk(uint32_t capacity);
+};
@@ -0,0 +1,332 @@
+/*!
+ * \file
+ * \brief Header file declaring the compressed postings format
+ *
+ * Header file declaring the compressed postings format.
+ * Postings of a term are cut into blocks of postingBlockSize entries. The docIds of a block are
+ * stored as varint-encoded gaps, the counts as varints in a parallel byte array, and a small header
+ * per block keeps the last docId of the block, so a cursor skips whole blocks without decoding them.
+ * Optionally the positions of the words in the documents are stored in a third byte array: the positions
+ * of every entry as varint-encoded gaps, one run per entry of the length of its count. The offsets of the runs
+ * of the blocks are kept in a separate array parallel to the headers, so the blocks of an index without positions
+ * are not changed and the positions are read only for the documents a phrase is checked in.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "flat_array.h"
+#include "index_file.h"
+
+static const size_t postingBlockSize = 128; //!< number of entries in a full block of postings
+
+/*!
+ * A structure containing the field of the document's Id  and a count field
+ * corresponding to the number of occurrences of a specific word in this document
+ */
+struct Entry {
+    size_t docId, count;
+//!< This operator is required for test scenarios
+    bool operator ==(const Entry& other) const {
+        return (docId == other.docId &&
+                count == other.count);
+    }
+};
+
+/*!
+ * An occurrence of a word: the document and the number of the word in the document, counted from 0
+ */
+struct Occurrence {
+    uint32_t docId, position;
+};
+
+/*!
+ * The function sorts entries by docId and sums up the entries of one document,
+ * it turns the postings collected by several threads or runs into the postings of a term.
+ * @param [in, out] entries the entries
+ */
+void sortEntries(std::vector<Entry> &entries);
+
+/*!
+ * The function sorts occurrences of a term and turns them into its postings with positions.
+ * @param [in, out] occurrences the occurrences, they are sorted by docId and position
+ * @param [out] entries the entries of the documents, the count of an entry is its number of occurrences
+ * @param [out] positions the positions of all the entries one after another
+ */
+void groupOccurrences(std::vector<Occurrence> &occurrences, std::vector<Entry> &entries,
+                      std::vector<uint32_t> &positions);
+
+/*!
+ * The header of one block of postings
+ */
+struct PostingBlock {
+    uint64_t docOffset;   //!< offset of the encoded docId gaps of the block
+    uint64_t countOffset; //!< offset of the encoded counts of the block
+    uint32_t lastDocId;   //!< the highest docId of the block
+    uint32_t maxCount;    //!< the highest count of the block
+};
+
+/*!
+ * Statistics and location of the postings of one term
+ */
+struct TermInfo {
+    uint32_t firstBlock;   //!< index of the first block of the term
+    uint32_t docFrequency; //!< number of documents containing the term
+    uint64_t totalCount;   //!< number of occurrences of the term in the whole document base
+    uint32_t maxCount;     //!< the highest count of the term in one document
+};
+
+/*!
+ * A read-only view of the compressed postings of one term. The view does not own the data, it stays
+ * valid until the next update of the document base.
+ */
+struct PostingList {
+    const PostingBlock *blocks = nullptr; //!< the blocks of the term
+    const uint8_t *docBytes = nullptr;    //!< encoded docIds of all the terms, addressed by the block offsets
+    const uint8_t *countBytes = nullptr;  //!< encoded counts of all the terms, addressed by the block offsets
+    const uint64_t *positionOffsets = nullptr; //!< offsets of the positions of the blocks of the term, nullptr without positions
+    const uint8_t *positionBytes = nullptr;    //!< encoded positions of all the terms, addressed by positionOffsets
+    size_t docFrequency = 0;              //!< number of documents containing the word (number of entries)
+    size_t totalCount = 0;                //!< number of occurrences of the word in the whole document base
+    size_t maxCount = 0;                  //!< the highest count of the word in one document, an upper bound of its score
+
+    bool empty() const { return docFrequency == 0; }
+
+    bool hasPositions() const { return positionOffsets != nullptr; }
+
+/*!
+ * The method decodes all the postings
+ * @return entries sorted by docId
+ */
+    std::vector<Entry> decode() const;
+};
+
+/*!
+ * \brief Cursor decoding the postings of one term block by block
+ *
+ * Cursor decoding the postings of one term block by block.
+ * Entries are visited in increasing docId order, seek skips the blocks that end before the target.
+ */
+class PostingCursor {
+public:
+    PostingCursor() = default;
+
+    explicit PostingCursor(const PostingList &inPostings);
+
+    bool isEnd() const { return position == blockEntries; }
+
+    uint32_t docId() const { return docIds[position]; }
+
+    uint32_t count() const {
+        if (!countsDecoded)
+            decodeCounts();
+        return counts[position];
+    }
+
+/*!
+ * The method moves the cursor to the next entry
+ */
+    void next();
+
+/*!
+ * The method moves the cursor to the first entry whose docId is not less than the target
+ * @param [in] target the docId to be found
+ */
+    void seek(uint32_t target);
+
+/*!
+ * The method decodes the positions of the current entry, the postings must have positions.
+ * The positions of the entries skipped in the block are decoded too, the other blocks are not read.
+ * @param [out] positions the positions in increasing order, count() of them
+ */
+    void getPositions(std::vector<uint32_t> &positions);
+
+private:
+    PostingList postings;
+    size_t block = 0;        //!< index of the decoded block
+    size_t blocksNum = 0;
+    size_t position = 0;     //!< position of the current entry in the decoded block
+    size_t blockEntries = 0; //!< number of entries in the decoded block
+    mutable bool countsDecoded = false; //!< counts are decoded on the first request, seek does not need them
+    size_t positionsEntry = 0;          //!< entry of the block whose positions are next in positionsBytes
+    const uint8_t *positionsBytes = nullptr; //!< positions of the block not decoded yet, nullptr before the first request
+    uint32_t docIds[postingBlockSize];
+    mutable uint32_t counts[postingBlockSize];
+
+    void decodeBlock(size_t newBlock);
+
+    void decodeCounts() const;
+};
+
+/*!
+ * \brief Cursor over the documents where the words of a phrase occur one after another
+ *
+ * Cursor over the documents where the words of a phrase occur one after another.
+ * The postings of the words are intersected by seeking every cursor to the highest docId of the others,
+ * so the blocks of the frequent words between the documents of the rare one are skipped, and the positions
+ * are decoded only for the documents that hold all the words. The count of a document is the number
+ * of matches of the phrase. With a slop, at most that many other words may stand between two neighbouring
+ * words of the phrase, which still occur in its order. A phrase of one word is its postings.
+ */
+class PhraseCursor {
+public:
+    PhraseCursor() = default;
+
+/*!
+ * @param [in] words postings of the words of the phrase in its order, they must have positions unless there is one word
+ * @param [in] inSlop the highest number of other words between two neighbouring words of the phrase
+ */
+    PhraseCursor(const std::vector<PostingList> &words, uint32_t inSlop);
+
+    bool isEnd() const { return cursors.empty() || cursors[0].isEnd(); }
+
+    uint32_t docId() const { return cursors[0].docId(); }
+
+    uint32_t count() const { return cursors.size() == 1 ? cursors[0].count() : matches; }
+
+/*!
+ * The method moves the cursor to the next document with a match
+ */
+    void next();
+
+/*!
+ * The method moves the cursor to the first document with a match whose docId is not less than the target
+ * @param [in] target the docId to be found
+ */
+    void seek(uint32_t target);
+
+private:
+    std::vector<PostingCursor> cursors; //!< cursors of the words, all of them are on the current document
+    uint32_t slop = 0;
+    uint32_t matches = 0;
+    std::vector<std::vector<uint32_t>> positions; //!< positions of every word in the current document
+
+/*!
+ * The method moves the cursors from their entries to the first document with a match
+ */
+    void findMatch();
+
+/*!
+ * The method counts the matches of the phrase in the document the cursors are on
+ * @return number of the positions of the first word that begin a match
+ */
+    uint32_t countMatches();
+};
+
+/*!
+ * \brief Storage of the compressed postings of all the terms
+ *
+ * Storage of the compressed postings of all the terms.
+ * Terms are appended in the order of their ids, the blocks and the encoded bytes of all the terms
+ * are kept in shared contiguous arrays.
+ */
+class PostingStore {
+public:
+/*!
+ * The method encodes the postings of the next term
+ * @param [in] entries entries of the term sorted by docId, docIds must fit in 32 bits
+ * @param [in] positions positions of the entries one after another, count of every entry, or nullptr;
+ * either all the terms of the store have positions or none of them
+ */
+    void append(const std::vector<Entry> &entries, const std::vector<uint32_t> *positions = nullptr);
+
+/*!
+ * The method for getting the postings of a term
+ * @param [in] termId id of the term, the number of append calls made before the term was added
+ * @return view of the postings
+ */
+    PostingList getPostings(uint32_t termId) const;
+
+/*!
+ * The method for getting the number of terms.
+ * @return number of terms
+ */
+    size_t size() const { return terms.size(); }
+
+/*!
+ * The method determines whether the positions of the words are stored.
+ * @return true if the terms were appended with positions
+ */
+    bool hasPositions() const { return !positionOffsets.empty(); }
+
+/*!
+ * The method for getting the memory used by the store.
+ * @return the memory of all the arrays
+ */
+    MemoryUsage getMemoryUsage() const {
+        MemoryUsage usage = terms.getMemoryUsage();
+        usage += blocks.getMemoryUsage();
+        usage += docBytes.getMemoryUsage();
+        usage += countBytes.getMemoryUsage();
+        usage += getPositionsMemoryUsage();
+        return usage;
+    }
+
+/*!
+ * The method for getting the memory used by the positions, it is a part of getMemoryUsage.
+ * @return the memory of the position arrays
+ */
+    MemoryUsage getPositionsMemoryUsage() const {
+        MemoryUsage usage = positionOffsets.getMemoryUsage();
+        usage += positionBytes.getMemoryUsage();
+        return usage;
+    }
+
+/*!
+ * The method removes all the postings.
+ */
+    void clear();
+
+/*!
+ * The method frees the unused capacity of the arrays, it is called when no more terms are appended.
+ */
+    void shrinkToFit();
+
+/*!
+ * The method writes the encoded bytes to files and frees them from memory. The offsets of the terms appended
+ * afterwards continue after the written bytes, so the files get the byte arrays of the whole store.
+ * The postings can't be read from the store afterwards, it is only written to an index file.
+ * The store must have no positions.
+ * @param [out] docFile the file of the encoded docIds
+ * @param [out] countFile the file of the encoded counts
+ */
+    void moveBytesTo(std::ostream &docFile, std::ostream &countFile);
+
+/*!
+ * The method adds the arrays of the store to an index file.
+ * @param [in] writer the file being written
+ */
+    void writeTo(IndexFileWriter &writer) const;
+
+/*!
+ * The method adds the arrays of the store to an index file, the encoded bytes are taken from the files
+ * they were written to by moveBytesTo.
+ * @param [in] writer the file being written
+ * @param [in] docBytesPath path to the file of the encoded docIds
+ * @param [in] countBytesPath path to the file of the encoded counts
+ */
+    void writeTo(IndexFileWriter &writer, const std::string &docBytesPath, const std::string &countBytesPath) const;
+
+/*!
+ * The method makes the store use the arrays stored in an index file.
+ * No terms may be appended to the store afterwards.
+ * @param [in] reader the opened file
+ * @param [in] docsAmount the number of documents, every docId of the blocks is below it
+ * @return true if the file has consistent posting arrays
+ */
+    bool readFrom(const IndexFileReader &reader, size_t docsAmount);
+
+private:
+    FlatArray<TermInfo, MemoryCategory::Postings> terms;
+    FlatArray<PostingBlock, MemoryCategory::Postings> blocks;
+    FlatArray<uint8_t, MemoryCategory::Postings> docBytes;
+    FlatArray<uint8_t, MemoryCategory::Postings> countBytes;
+    FlatArray<uint64_t, MemoryCategory::Postings> positionOffsets; //!< offset of the positions of every block
+    FlatArray<uint8_t, MemoryCategory::Postings> positionBytes;
+    uint64_t movedDocBytes = 0;   //!< number of encoded docId bytes written out by moveBytesTo
+    uint64_t movedCountBytes = 0; //!< number of encoded count bytes written out by moveBytesTo
+};
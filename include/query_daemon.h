@@ -0,0 +1,107 @@
+/*!
+ * \file
+ * \brief Header file declaring the QueryDaemon class
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include "search_server.h"
+#include "status.h"
+
+/*!
+ * \brief Long-running server answering the requests with a resident index
+ *
+ * Long-running server answering the requests with a resident index.
+ * A client sends one JSON object per line and gets one line back for every line, in the same order:
+ * - {"requests": ["milk water", ...]} is answered in the shape of answers.json, {"answers": [...]};
+ * - {"top": ["milk water", ...]} is answered with the absolute relevance of the best documents for every request,
+ *   {"top": [[[docId, absolute], ...], ...]}, it is used by ShardCoordinator to rank the documents of all the shards;
+ * - {"command": "documents"} is answered with the number of documents of the index, {"documents": n};
+ * - {"command": "stats"} is answered with the statistics of the result cache;
+ * - {"command": "metrics"} is answered with the timings and counters of the engine, see Metrics;
+ * - a line that can't be parsed is answered with {"error": "..."}.
+ * The lines of one client are pipelined: the client may send the next requests without waiting for the answers,
+ * they are searched at the same time by the shared pool and written back in the order of the lines.
+ * The clients are served by standard input and output or by a local Unix domain socket, every connection
+ * of the socket has its own threads.
+ * A daemon made with a search function instead of a SearchServer, for example the one of ShardCoordinator,
+ * answers only the requests and the metrics.
+ */
+class QueryDaemon {
+public:
+    typedef std::function<bool(std::string &line)> line_reader_t;        //!< reads the next line, false at the end
+    typedef std::function<bool(const std::string &line)> line_writer_t;  //!< writes a line, false if the client is gone
+    typedef std::function<std::vector<std::vector<RelativeIndex>>(const std::vector<std::string> &requests)>
+            search_function_t; //!< answers a batch of requests like SearchServer::search
+
+/*!
+ * @param [in] inServer the server searching the index, it must outlive the daemon
+ * @param [in] inMaxPipelined the highest number of lines of one client searched at the same time
+ */
+    explicit QueryDaemon(SearchServer &inServer, size_t inMaxPipelined = 64);
+
+/*!
+ * @param [in] inSearch the function answering the requests
+ * @param [in] inMaxPipelined the highest number of lines of one client searched at the same time
+ */
+    explicit QueryDaemon(search_function_t inSearch, size_t inMaxPipelined = 64);
+
+    QueryDaemon(const QueryDaemon &) = delete;
+    QueryDaemon &operator=(const QueryDaemon &) = delete;
+
+/*!
+ * The method serves one client until it closes its input.
+ * @param [in] readLine the function reading the lines of the client
+ * @param [in] writeLine the function writing the answers to the client
+ */
+    void serveConnection(const line_reader_t &readLine, const line_writer_t &writeLine);
+
+/*!
+ * The method serves the client on the standard input and output until the input is closed.
+ */
+    void serveStdio();
+
+/*!
+ * The method listens on a Unix domain socket and serves the clients until stop is called.
+ * The socket file is replaced if it exists and removed when the method returns.
+ * @param [in] path path to the socket file
+ * @return operation status:
+ * OK - the daemon was stopped;
+ * ERROR - the socket can't be created or Unix domain sockets are not supported.
+ */
+    status serveSocket(const std::string &path);
+
+/*!
+ * The method stops serveSocket and closes the connections of the clients, it may be called from any thread.
+ */
+    void stop();
+
+/*!
+ * The method processes one line of a client.
+ * @param [in] line the line
+ * @return the answer without the line end
+ */
+    std::string processLine(const std::string &line);
+
+private:
+    SearchServer *server;            //!< the server, nullptr if the daemon was made with a search function
+    search_function_t search;
+    const size_t maxPipelined;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> listenSocket{-1};
+    std::mutex clientsAccess;
+    std::condition_variable clientsDone;
+    std::set<int> clientSockets;           //!< sockets of the connected clients, guarded by clientsAccess
+
+/*!
+ * The method serves one client of the socket and closes its socket.
+ * @param [in] clientSocket the socket of the client
+ */
+    void serveClient(int clientSocket);
+};
@@ -3,14 +3,17 @@
 //
 /*!
  * \file
- * \brief Header file declaring the RelativeIndex structure and 
+ * \brief Header file declaring the RelativeIndex and AbsoluteIndex structures and
  * the SearchServer class
  */
 
 #pragma once
 
-#include <unordered_set>
+#include <cstdint>
+#include <memory>
+#include <atomic>
 #include "inverted_index.h"
+#include "lru_cache.h"
 
 
 /*!
@@ -25,55 +28,188 @@ struct RelativeIndex {
     }
 };
 
+/*!
+ * A structure containing the document's Id field and the absolute relevance of this document for a particular
+ * search query, the sum of the occurrences of the words of the query in the document.
+ */
+struct AbsoluteIndex {
+    size_t docId;
+    size_t absolute;
+    bool operator ==(const AbsoluteIndex &other) const {
+        return (docId == other.docId && absolute == other.absolute);
+    }
+};
+
+/*!
+ * \brief Search over a snapshot of the index
+ *
+ * Search over a snapshot of the index.
+ * The server holds the index through a shared pointer to a constant snapshot. A new snapshot is published
+ * with setIndex atomically: a batch of queries takes the current snapshot when it starts and finishes on it,
+ * the old snapshot is freed by the last batch that uses it. A snapshot is prepared by copying the current one,
+ * which shares its segments, and updating the copy, so reindexing never stops the search and never holds
+ * two copies of the postings.
+ * The results are cached by the normalized query: the sorted unique words and phrases and the limit
+ * of the responses. Every snapshot has its own version, a cached result is used only with the snapshot it was found in.
+ * If the index has positions, the words in double quotes are a phrase, "a b"~N allows N other words
+ * between two words of the phrase. A phrase is scored like a word occurring as many times as it is found.
+ */
 class SearchServer {
 public:
 /*!
- * @param idx a reference to the InvertedIndex class is passed to the class constructor 
- * so that SearchServer can find out the frequency of words found in the request
+ * @param inIndex the snapshot of the index to search
+ */
+    explicit SearchServer(std::shared_ptr<const InvertedIndex> inIndex);
+
+/*!
+ * @param inIndex the index, the server searches a copy of it, which shares its segments
  */
-    explicit SearchServer(InvertedIndex &inIndex);
+    explicit SearchServer(const InvertedIndex &inIndex);
 
 /*!
- * The method of processing search queries
+ * The method publishes a new snapshot of the index. The batches that are running finish on the old snapshot.
+ * @param inIndex the snapshot
+ */
+    void setIndex(std::shared_ptr<const InvertedIndex> inIndex);
+
+/*!
+ * The method for getting the current snapshot of the index.
+ * @return the snapshot, it stays valid while the pointer is held
+ */
+    std::shared_ptr<const InvertedIndex> getIndex() const;
+
+/*!
+ * The method of processing search queries. The queries are distributed among the number of threads
+ * set by the search_threads field of config.json.
  * @param [in] queriesInput search requests taken from the requests.json file
- * @return sorted list of relevant responses for given queries
+ * @return sorted list of relevant responses for given queries, in the order of the queries
  */
     std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string> &queriesInput);
+
+/*!
+ * The method of processing search queries without the normalization of the relevance. The documents
+ * of several indexes are ranked together by merging their absolute relevance, see ShardCoordinator.
+ * @param [in] queriesInput search requests
+ * @return the documents with the highest absolute relevance for every query, the best first,
+ * at most the limit of the responses per query
+ */
+    std::vector<std::vector<AbsoluteIndex>> searchAbsolute(const std::vector<std::string> &queriesInput);
+
+/*!
+ * The method for getting the statistics of the result cache, whose capacity is set by the cache_capacity
+ * field of config.json.
+ * @return the statistics
+ */
+    CacheStats getCacheStats();
 private:
-    InvertedIndex index;
+/*!
+ * A published index with its version
+ */
+    struct Snapshot {
+        std::shared_ptr<const InvertedIndex> index;
+        uint64_t version;
+    };
+
+/*!
+ * A phrase of a query, its words are found in their order with at most slop other words between two of them
+ */
+    struct Phrase {
+        std::vector<std::string> words;
+        uint32_t slop;
+        bool operator <(const Phrase &other) const {
+            return words < other.words || (words == other.words && slop < other.slop);
+        }
+        bool operator ==(const Phrase &other) const {
+            return words == other.words && slop == other.slop;
+        }
+    };
+
+    std::shared_ptr<const Snapshot> snapshot; //!< the current snapshot, read and replaced only with std::atomic_load and std::atomic_store
+    std::atomic<uint64_t> nextVersion{0};
+    LruCache<std::vector<AbsoluteIndex>> cache; //!< the results are cached with the version of their snapshot
+
+/*!
+ * The method for getting the current snapshot with its version.
+ * @return the snapshot
+ */
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+
+/*!
+ * The method searches a batch of queries in one snapshot, the queries are distributed among the threads.
+ * @param [in] queriesInput search requests
+ * @param [in] process the function receiving the number of a query, its top documents and the limit of the responses
+ */
+    template<typename Process>
+    void searchBatch(const std::vector<std::string> &queriesInput, const Process &process);
 
 /*!
- * The method returns a list of unique words for the query
+ * The method of processing one search query. It only reads the index, so the queries of a batch
+ * are processed by several threads at once. The result is taken from the cache if the same words
+ * were searched in the snapshot before.
+ * @param [in] current the snapshot
  * @param [in] request the query
- * @return list of unique words
+ * @param [in] limit the maximum number of responses
+ * @return the documents with the highest absolute relevance, the best first
  */
-    static std::unordered_set<std::string> getUniqueWords(const std::string &request);
+    std::vector<AbsoluteIndex> searchOne(const Snapshot &current, const std::string &request, size_t limit);
 
 /*!
- * The method sorts unique words in order of increasing frequency of occurrence according to 
- * the frequency dictionary.
- * @param [in] uniqueWords unique query words
- * @return sorted list of unique words
+ * The method returns the unique words of the query.
+ * @param [in] request the query
+ * @param [in] lowercase whether the words are turned to lowercase, like the words of the documents
+ * @return the unique words in alphabetical order
  */
-    std::vector<std::string> sortUniqueWords(const std::unordered_set<std::string> &uniqueWords);
+    static std::vector<std::string> getUniqueWords(const std::string &request, bool lowercase);
 
 /*!
- * The method calculates the absolute relevance value for one document
- * @param [in] Id of the document for which the absolute relevance value is calculated
- * @param [in] words a set of words by which the absolute relevance of a document is calculated
- * @return absolute relevance value
+ * The method takes the phrases in double quotes out of the query, the text of an unclosed quote is left
+ * as the words of the query. A phrase of one word is left as a word.
+ * @param [in, out] request the query, the phrases are replaced by spaces
+ * @param [in] lowercase whether the words are turned to lowercase, like the words of the documents
+ * @return the unique phrases in alphabetical order
  */
-    size_t calcAbsoluteForDoc(size_t &id, std::vector<std::string> &words);
+    static std::vector<Phrase> takePhrases(std::string &request, bool lowercase);
 
+/*!
+ * \brief The method selects the documents with the highest absolute relevance
+ *
+ * The method selects the documents with the highest absolute relevance.
+ * The postings of the words are walked document-at-a-time and the best documents are kept in a heap
+ * bounded by the limit. Once the heap is full, the words whose upper bounds together cannot lift a document
+ * above the worst kept one are only looked up for documents found through the other words (MaxScore),
+ * so the documents that cannot reach the top are skipped. The segments of the index are walked one after
+ * another with one heap, a document is scored only by the segment that holds its live version.
+ * A phrase is walked by a PhraseCursor, which intersects the postings of its words by their skip pointers
+ * and reads the positions only of the documents holding all of them.
+ * @param [in] snapshot the index
+ * @param [in] words the words by which the absolute relevance of a document is calculated
+ * @param [in] phrases the phrases added to the relevance, they need an index with positions
+ * @param [in] limit the maximum number of documents to select
+ * @param [out] Ids the selected documents
+ * @param [out] absolutes absolute relevance values of the documents from Ids
+ */
+    static void calcTopAbsolutes(const InvertedIndex &snapshot, const std::vector<std::string> &words,
+                                 const std::vector<Phrase> &phrases, size_t limit,
+                                 std::vector<size_t> &Ids, std::vector<size_t> &absolutes);
+public:
 /*!
  * The method calculates the relative relevance for each document from a vector of documents
  * @param [in] Ids vector of documents to be searched
  * @param [in] absolutes absolute relevance vector for document vector
+ * @param [in] limit the maximum number of responses
  * @param [out] indexes vector of indexes of relative relevance for the vector of documents
  */
-    static void calcRelative(std::vector<size_t> &Ids, std::vector<size_t> &absolutes, 
+    static void calcRelative(std::vector<size_t> &Ids, std::vector<size_t> &absolutes, size_t limit,
 		std::vector<RelativeIndex> &indexes);
-public:
+
+/*!
+ * The method calculates the relative relevance of the documents selected by their absolute relevance
+ * @param [in] top the documents with their absolute relevance
+ * @param [in] limit the maximum number of responses
+ * @return sorted list of relevant responses
+ */
+    static std::vector<RelativeIndex> getRelative(const std::vector<AbsoluteIndex> &top, size_t limit);
+
 /*!
  * Method that converts data of type std::vector<std::vector<RelativeIndex>> to 
  * std::vector<std::vector<std::pair<int, double>>> for further work with ConverterJSON class methods
@@ -0,0 +1,133 @@
+/*!
+ * \file
+ * \brief Header file declaring the ShardCoordinator class
+ */
+
+#pragma once
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+#include "status.h"
+
+/*!
+ * \brief Search over several shards of the documents, each served by its own process
+ *
+ * Search over several shards of the documents, each served by its own process.
+ * The files of config.json are split into contiguous ranges of about the same size. Every range is indexed
+ * and searched by a worker process, the same executable started with --shard-worker, which keeps its own
+ * index file and answers a QueryDaemon on a Unix domain socket. A batch of requests is sent to all the shards
+ * at once, every shard answers the documents with the highest absolute relevance, and the lists are merged
+ * by the absolute relevance before it is normalized. Since the docIds of a shard are the docIds of its range
+ * shifted by the number of documents of the shards before it, the answers equal the ones of a single index
+ * of all the files, also when some files can't be opened.
+ * The batches sent from several threads are pipelined on the sockets. The workers are stopped
+ * by the destructor, and on Linux also when the coordinator dies.
+ */
+class ShardCoordinator {
+public:
+/*!
+ * @param [in] inExecutable path to the executable of the workers
+ * @param [in] inShardsNum the number of shards
+ */
+    ShardCoordinator(std::string inExecutable, size_t inShardsNum);
+
+    ShardCoordinator(const ShardCoordinator &) = delete;
+    ShardCoordinator &operator=(const ShardCoordinator &) = delete;
+
+/*!
+ * The destructor stops the workers and removes their sockets.
+ */
+    ~ShardCoordinator();
+
+/*!
+ * The method starts the workers and waits until every shard is indexed and connected.
+ * @param [in] sources the files of the documents
+ * @return operation status:
+ * OK - all the shards are ready;
+ * ERROR - a worker can't be started or has quit, or processes are not supported on this system.
+ */
+    status start(const std::vector<DocumentSource> &sources);
+
+/*!
+ * The method of processing search queries on all the shards.
+ * An std::runtime_error is thrown if a shard has quit.
+ * @param [in] queriesInput search requests
+ * @return sorted list of relevant responses for given queries, in the order of the queries,
+ * the same as SearchServer::search over all the documents
+ */
+    std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string> &queriesInput);
+
+/*!
+ * The method splits the files into contiguous ranges with about the same number of bytes.
+ * @param [in] sources the files
+ * @param [in] shardsNum the number of ranges, it is lowered to the number of files
+ * @return the first file of every range followed by the number of files
+ */
+    static std::vector<size_t> splitFiles(const std::vector<DocumentSource> &sources, size_t shardsNum);
+
+/*!
+ * The method merges the best documents of the shards and calculates their relative relevance.
+ * @param [in] tops the best documents of every shard with the global docIds
+ * @param [in] limit the maximum number of responses
+ * @return sorted list of relevant responses
+ */
+    static std::vector<RelativeIndex> mergeTops(const std::vector<std::vector<AbsoluteIndex>> &tops, size_t limit);
+
+/*!
+ * The method calculates the first global docId of every shard. The files that can't be opened get no docIds,
+ * so a shard starts after the documents of the shards before it rather than after their files.
+ * @param [in] docsAmounts the number of documents of every shard
+ * @return the first docId of every shard
+ */
+    static std::vector<size_t> getOffsets(const std::vector<size_t> &docsAmounts);
+
+private:
+/*!
+ * A worker process with its connection
+ */
+    struct Shard {
+        int pid = -1;
+        int socket = -1;
+        std::string path;                            //!< path to the socket of the worker
+        size_t offset = 0;                           //!< the first global docId of the shard, added to its docIds
+        std::mutex sendAccess;                       //!< keeps the lines and their promises in the same order
+        std::mutex pendingAccess;
+        std::deque<std::promise<std::string>> pending; //!< answers not received yet, guarded by pendingAccess
+        bool failed = false;                         //!< the connection is lost, guarded by pendingAccess
+        std::thread reader;
+    };
+
+    std::string executable;
+    size_t shardsNum;
+    size_t limit = 5;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+/*!
+ * The method sends a line to a shard.
+ * @param [in] shard the shard
+ * @param [in] line the line without the line end
+ * @return the future answer, it holds an std::runtime_error if the shard has quit
+ */
+    static std::future<std::string> send(Shard &shard, const std::string &line);
+
+/*!
+ * The method receives the answers of a shard until its connection is closed.
+ * @param [in] shard the shard
+ */
+    static void receive(Shard &shard);
+
+/*!
+ * The method connects to a worker, waiting while it builds its index.
+ * @param [in] shard the shard
+ * @return operation status:
+ * OK - the shard is connected;
+ * ERROR - the worker has quit.
+ */
+    static status connectShard(Shard &shard);
+};
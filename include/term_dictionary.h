@@ -0,0 +1,133 @@
+/*!
+ * \file
+ * \brief Header file declaring the TermDictionary class
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "flat_array.h"
+#include "index_file.h"
+#include "text_view.h"
+
+/*!
+ * \brief Dictionary that interns terms and maps them to dense integer ids
+ *
+ * Dictionary that interns terms and maps them to dense integer ids.
+ * The characters of all terms are stored one after another in a single arena, the term with id i
+ * occupies [offsets[i], offsets[i + 1]). Terms are found through an open-addressing hash table with
+ * linear probing that stores term ids, so a lookup touches one contiguous array and compares at most
+ * a few strings.
+ */
+class TermDictionary {
+public:
+    static const uint32_t npos = UINT32_MAX; //!< id returned for a term that is not in the dictionary
+
+    TermDictionary();
+
+/*!
+ * The method finds the id of a term.
+ * @param [in] data the characters of the term
+ * @param [in] size the length of the term
+ * @return id of the term, npos if the term is not in the dictionary
+ */
+    uint32_t find(const char *data, size_t size) const;
+
+    uint32_t find(const std::string &term) const { return find(term.data(), term.size()); }
+
+/*!
+ * The method adds a term to the dictionary if it is not there yet.
+ * @param [in] data the characters of the term
+ * @param [in] size the length of the term
+ * @return id of the term, ids are given out in the order in which terms are added
+ */
+    uint32_t insert(const char *data, size_t size);
+
+    uint32_t insert(const std::string &term) { return insert(term.data(), term.size()); }
+
+/*!
+ * The method for getting a term by its id.
+ * @param [in] id id of the term
+ * @return the term
+ */
+    std::string getTerm(uint32_t id) const;
+
+/*!
+ * The method for getting the characters of a term without copying them.
+ * @param [in] id id of the term
+ * @return view of the term, valid until the next term is added
+ */
+    TextView getTermView(uint32_t id) const {
+        return TextView(arena.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+/*!
+ * The method for getting the number of terms.
+ * @return number of terms
+ */
+    size_t size() const { return hashes.size(); }
+
+/*!
+ * The method for getting the memory used by the dictionary.
+ * @return the memory of all the arrays
+ */
+    MemoryUsage getMemoryUsage() const {
+        MemoryUsage usage = arena.getMemoryUsage();
+        usage += offsets.getMemoryUsage();
+        usage += hashes.getMemoryUsage();
+        usage += slots.getMemoryUsage();
+        return usage;
+    }
+
+/*!
+ * The method for getting the term ids in the alphabetical order of the terms, the terms are compared
+ * byte by byte like std::string does.
+ * @return the ids
+ */
+    std::vector<uint32_t> getSortedIds() const;
+
+/*!
+ * The method removes all the terms.
+ */
+    void clear();
+
+/*!
+ * The method frees the unused capacity of the arrays, it is called when no more terms are added.
+ */
+    void shrinkToFit();
+
+/*!
+ * The method adds the arrays of the dictionary to an index file.
+ * @param [in] writer the file being written
+ */
+    void writeTo(IndexFileWriter &writer) const;
+
+/*!
+ * The method makes the dictionary use the arrays stored in an index file.
+ * No terms may be added to the dictionary afterwards.
+ * @param [in] reader the opened file
+ * @return true if the file has consistent dictionary arrays
+ */
+    bool readFrom(const IndexFileReader &reader);
+
+private:
+    FlatArray<char, MemoryCategory::Dictionary> arena;       //!< characters of all the terms
+    FlatArray<uint32_t, MemoryCategory::Dictionary> offsets; //!< offsets of the terms in the arena, one more than the number of terms
+    FlatArray<uint32_t, MemoryCategory::Dictionary> hashes;  //!< hash of every term, used to skip string compares and to grow the table
+    FlatArray<uint32_t, MemoryCategory::Dictionary> slots;   //!< hash table of term ids, npos marks an empty slot, the size is a power of 2
+
+    static uint32_t hash(const char *data, size_t size);
+
+/*!
+ * The method finds the slot of a term.
+ * @return the slot holding the term, or the empty slot where the term would be placed
+ */
+    size_t findSlot(const char *data, size_t size, uint32_t termHash) const;
+
+/*!
+ * The method doubles the hash table and places all the terms into it again.
+ */
+    void grow();
+};
@@ -0,0 +1,26 @@
+/*!
+ * \file
+ * \brief Header file declaring the TextView structure
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * \brief Read-only view of a text stored elsewhere
+ *
+ * Read-only view of a text stored elsewhere, for example in a string or in a memory-mapped file.
+ * The documents are indexed through views, so a text is never copied on its way from the file to the index.
+ */
+struct TextView {
+    const char *data = nullptr; //!< the first character
+    size_t size = 0;            //!< number of characters
+
+    TextView() = default;
+
+    TextView(const char *inData, size_t inSize) : data(inData), size(inSize) {}
+
+    TextView(const std::string &text) : data(text.data()), size(text.size()) {}
+};
@@ -0,0 +1,122 @@
+/*!
+ * \file
+ * \brief Header file declaring the ThreadPool class
+ *
+ * Header file declaring the ThreadPool class, the long-lived executor shared by document loading,
+ * index building and searching.
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/*!
+ * \brief Pool of worker threads with work-stealing task queues
+ *
+ * Pool of worker threads with work-stealing task queues.
+ * Every worker has its own queue: it takes the newest task from its queue and, when the queue is empty,
+ * steals the oldest task from the queue of another worker. The threads are created once and live until
+ * the pool is resized or destroyed, so the hot paths never create threads.
+ */
+class ThreadPool {
+public:
+/*!
+ * @param [in] threadsNum number of worker threads, the number of hardware threads if 0
+ * @param [in] pinned pin the worker threads to the processor cores
+ */
+    explicit ThreadPool(size_t threadsNum = 0, bool pinned = false);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+/*!
+ * The method returns the pool shared by the whole application
+ * @return the shared pool
+ */
+    static ThreadPool &shared();
+
+/*!
+ * The method recreates the worker threads. It must not be called while the pool has tasks.
+ * @param [in] threadsNum number of worker threads, the number of hardware threads if 0
+ * @param [in] pinned pin the worker threads to the processor cores
+ */
+    void setThreadsNumber(size_t threadsNum, bool pinned = false);
+
+/*!
+ * The method for getting the number of worker threads.
+ * @return number of worker threads
+ */
+    size_t getThreadsNumber() const;
+
+/*!
+ * The method adds a task to the pool. A task submitted from a worker thread goes to the queue
+ * of this worker, other tasks are distributed among the queues in turn.
+ * @param [in] task the task to be executed
+ */
+    void submit(std::function<void()> task);
+
+/*!
+ * \brief The method calls body(i) for every i in [0, amount) and waits for all the calls to finish
+ *
+ * The method calls body(i) for every i in [0, amount) and waits for all the calls to finish.
+ * The indexes are claimed one by one by up to maxTasks tasks, the calling thread is one of them.
+ * While waiting, the calling thread executes the tasks of the pool, so the method may be called from a task.
+ * When there is nothing to execute, it sleeps until one of its tasks finishes or a new task is submitted.
+ * @param [in] amount the number of indexes
+ * @param [in] body the function to be called for every index
+ * @param [in] maxTasks the maximum number of threads processing the indexes at the same time, 0 - no limit
+ */
+    void parallelFor(size_t amount, const std::function<void(size_t)> &body, size_t maxTasks = 0);
+
+private:
+/*!
+ * The queue of one worker thread
+ */
+    struct WorkerQueue {
+        std::mutex access;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<size_t> queuedTasks{0};  //!< number of tasks waiting in all the queues
+    std::atomic<size_t> nextQueue{0};    //!< queue for the next task submitted from outside the pool
+    std::mutex sleepAccess;
+    std::condition_variable wakeUp;
+    std::condition_variable callersWakeUp; //!< wakes the callers of parallelFor waiting for their tasks
+    bool stopping = false;               //!< guarded by sleepAccess
+
+    void startWorkers(size_t threadsNum, bool pinned);
+
+    void stopWorkers();
+
+    void workerLoop(size_t workerId);
+
+/*!
+ * The method executes one queued task, preferring the queue of the given worker.
+ * @param [in] workerId id of the worker whose queue is checked first, or queues.size() for other threads
+ * @return true if a task was executed
+ */
+    bool runPendingTask(size_t workerId);
+
+/*!
+ * The method returns the id of the calling worker thread of this pool.
+ * @return id of the worker, or queues.size() if the calling thread is not a worker of this pool
+ */
+    size_t currentWorkerId() const;
+
+/*!
+ * The method binds the calling thread to one processor core.
+ * @param [in] core the number of the core
+ */
+    static void pinToCore(size_t core);
+};
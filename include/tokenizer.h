@@ -0,0 +1,95 @@
+/*!
+ * \file
+ * \brief Header file declaring the Tokenizer class
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "text_view.h"
+
+/*!
+ * The instructions used to find the delimiters of the words
+ */
+enum class ScannerType {
+    Scalar, //!< one character at a time, available everywhere
+    SSE2,   //!< 16 characters at a time
+    AVX2    //!< 32 characters at a time, chosen at run time if the processor supports it
+};
+
+/*!
+ * \brief Splitter of a text into words
+ *
+ * Splitter of a text into words, shared by the indexing and the search so that both see the same words.
+ * A word is a run of characters that are not delimiters, the delimiters are the whitespace characters
+ * of the "C" locale: space, \\t, \\n, \\v, \\f and \\r. The text is classified 64 characters at a time
+ * into a bit mask of delimiters, and the words are then found with bit operations on the mask, so the cost
+ * does not depend on the length of the words. Every scanner produces the same words.
+ */
+class Tokenizer {
+public:
+/*!
+ * @param [in] inText the text, it must stay unchanged while the tokenizer is used
+ * @param [in] inLowercase whether the ASCII letters of the words are turned to lowercase
+ * @param [in] scanner the instructions to use, the scalar ones are used if the processor does not support them
+ */
+    explicit Tokenizer(TextView inText, bool inLowercase = false, ScannerType scanner = getBestScanner());
+
+/*!
+ * The method finds the next word of the text.
+ * @param [out] word view of the word, valid until the next call if the word was turned to lowercase
+ * @return false if the text has no more words
+ */
+    bool next(TextView &word);
+
+/*!
+ * The method determines whether a character separates the words.
+ * @param [in] c the character
+ * @return true for the whitespace characters of the "C" locale
+ */
+    static bool isDelimiter(char c) {
+        return c == ' ' || (unsigned char) (c - '\t') <= '\r' - '\t';
+    }
+
+/*!
+ * The method for getting the fastest scanner supported by the processor.
+ * @return the scanner
+ */
+    static ScannerType getBestScanner();
+
+/*!
+ * The method determines whether the processor supports a scanner.
+ * @param [in] scanner the scanner
+ * @return true if the scanner can be used
+ */
+    static bool isSupported(ScannerType scanner);
+
+private:
+    typedef uint64_t (*mask_function_t)(const char *block);
+
+    static const size_t blockSize = 64; //!< number of characters classified at a time, one bit of the mask each
+
+    const char *text;
+    size_t size;
+    bool lowercase;
+    mask_function_t getDelimiterMask; //!< bit i of the mask is set if block[i] is a delimiter
+    size_t blockBegin = 0;            //!< position of the classified block in the text
+    size_t offset = 0;                //!< position in the classified block
+    uint64_t delimiters = 0;          //!< the mask of the classified block
+    std::string lowered;              //!< the last word turned to lowercase
+
+/*!
+ * The method finds the next character that is (or is not) a delimiter, starting from the current position.
+ * @param [in] isDelimiter whether a delimiter is looked for
+ * @param [out] position position of the character in the text, the size of the text if a delimiter is
+ * looked for and the text ends first
+ * @return false if the text ends first and a word character is looked for
+ */
+    bool find(bool isDelimiter, size_t &position);
+
+/*!
+ * The method classifies the block of the text that starts at blockBegin
+ */
+    void classifyBlock();
+};
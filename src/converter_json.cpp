@@ -4,9 +4,13 @@
 
 #include <iostream>
 #include <cassert>
+#include <thread>
+#include <sys/stat.h>
 #include "file_exchange.h"
 #include "app_version.h"
 #include "converter_json.h"
+#include "metrics.h"
+#include "thread_pool.h"
 
 
 nlohmann::json JSON::config = 0;
@@ -48,18 +52,38 @@ status ConfigInit::checkCorrectConfig() {
 }
 
 std::vector<std::string> ConverterJSON::getTextDocuments() {
-
-    std::vector<std::string> texts;
     assert(!JSON::config["files"].empty());
-    for (auto & filePath : JSON::config["files"]) {
-        std::string text;
-        std::string path = filePath;
-        if (FileExchange::readFromFile(text, path, true) == status::OK)
-            texts.push_back(text);
+    std::vector<std::string> paths;
+    for (auto & filePath : JSON::config["files"])
+        paths.push_back(filePath);
+
+    std::vector<std::string> texts(paths.size());
+    std::vector<status> statuses(paths.size());
+    ThreadPool::shared().parallelFor(paths.size(), [&paths, &texts, &statuses](size_t i) {
+        statuses[i] = FileExchange::readFromFile(texts[i], paths[i], true);
+    });
+
+    ///< Files that could not be read are skipped, the rest keep their order
+    size_t loaded = 0;
+    for (size_t i = 0; i < texts.size(); i++) {
+        if (statuses[i] != status::OK)
+            continue;
+        if (loaded != i)
+            texts[loaded] = std::move(texts[i]);
+        loaded++;
     }
+    texts.resize(loaded);
     return texts;
 }
 
+std::vector<std::string> ConverterJSON::getDocumentPaths() {
+    assert(!JSON::config["files"].empty());
+    std::vector<std::string> paths;
+    for (auto & filePath : JSON::config["files"])
+        paths.push_back(filePath);
+    return paths;
+}
+
 size_t ConverterJSON::getResponsesLimit() {
     if (JSON::config["config"]["max_responses"].empty() || JSON::config["config"]["max_responses"] < 1)
         return 5;
@@ -67,6 +91,122 @@ size_t ConverterJSON::getResponsesLimit() {
     return JSON::config["config"]["max_responses"];
 }
 
+size_t ConverterJSON::getSearchThreadsNumber() {
+    if (JSON::config["config"]["search_threads"].empty() || JSON::config["config"]["search_threads"] < 1)
+        return std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+
+    return JSON::config["config"]["search_threads"];
+}
+
+size_t ConverterJSON::getCacheCapacity() {
+    if (!JSON::config["config"]["cache_capacity"].is_number_integer() || JSON::config["config"]["cache_capacity"] < 0)
+        return 1024;
+
+    return JSON::config["config"]["cache_capacity"];
+}
+
+size_t ConverterJSON::getThreadsNumber() {
+    if (JSON::config["config"]["threads"].empty() || JSON::config["config"]["threads"] < 1)
+        return 0;
+
+    return JSON::config["config"]["threads"];
+}
+
+bool ConverterJSON::isThreadsPinned() {
+    if (!JSON::config["config"]["pin_threads"].is_boolean())
+        return false;
+
+    return JSON::config["config"]["pin_threads"];
+}
+
+size_t ConverterJSON::getShardsNumber() {
+    if (JSON::config["config"]["shards"].empty() || JSON::config["config"]["shards"] < 1)
+        return 0;
+
+    return JSON::config["config"]["shards"];
+}
+
+std::vector<DocumentSource> ConverterJSON::getDocumentSources() {
+    std::vector<DocumentSource> sources;
+    for (auto & filePath : JSON::config["files"]) {
+        DocumentSource source;
+        source.path = filePath;
+        struct stat fileStat{};
+        if (stat(source.path.c_str(), &fileStat) == 0) {
+            source.size = (uint64_t) fileStat.st_size;
+            source.modified = (int64_t) fileStat.st_mtime;
+        }
+        sources.push_back(source);
+    }
+    return sources;
+}
+
+std::string ConverterJSON::getIndexPath() {
+    if (!JSON::config["config"]["index_path"].is_string())
+        return "";
+
+    return JSON::config["config"]["index_path"];
+}
+
+bool ConverterJSON::isIndexRebuiltIfChanged() {
+    if (!JSON::config["config"]["rebuild_index_if_changed"].is_boolean())
+        return true;
+
+    return JSON::config["config"]["rebuild_index_if_changed"];
+}
+
+bool ConverterJSON::isIndexVerified() {
+    if (!JSON::config["config"]["verify_index"].is_boolean())
+        return false;
+
+    return JSON::config["config"]["verify_index"];
+}
+
+bool ConverterJSON::isLowercase() {
+    if (!JSON::config["config"]["lowercase"].is_boolean())
+        return false;
+
+    return JSON::config["config"]["lowercase"];
+}
+
+bool ConverterJSON::isPositionsIndexed() {
+    if (!JSON::config["config"]["positions"].is_boolean())
+        return false;
+
+    return JSON::config["config"]["positions"];
+}
+
+IngestSettings ConverterJSON::getIngestSettings() {
+    ///< A missing or wrong field is left 0, the pipeline puts its default value instead
+    auto getField = [] (const char *name) -> size_t {
+        if (!JSON::config["config"][name].is_number_integer() || JSON::config["config"][name] < 0)
+            return 0;
+        return JSON::config["config"][name];
+    };
+    IngestSettings settings;
+    settings.readers = getField("ingest_readers");
+    settings.tokenizers = getField("ingest_tokenizers");
+    settings.indexers = getField("ingest_indexers");
+    settings.queueDepth = getField("ingest_queue_depth");
+    settings.blockSize = getField("ingest_block_size");
+    settings.memoryBudget = getField("ingest_memory_budget");
+    return settings;
+}
+
+bool ConverterJSON::isIngestStatsPrinted() {
+    if (!JSON::config["config"]["ingest_stats"].is_boolean())
+        return false;
+
+    return JSON::config["config"]["ingest_stats"];
+}
+
+std::string ConverterJSON::getMetricsPath() {
+    if (!JSON::config["config"]["metrics_path"].is_string())
+        return "";
+
+    return JSON::config["config"]["metrics_path"];
+}
+
 std::vector<std::string> ConverterJSON::getRequests() {
     std::vector<std::string> requests;
     if (FileExchange::readFromFile(JSON::requests, "requests.json") == status::OK) {
@@ -77,30 +217,131 @@ std::vector<std::string> ConverterJSON::getRequests() {
     return requests;
 }
 
-status ConverterJSON::putAnswers(std::vector<std::vector<std::pair<size_t, double>>> answers) {
-    std::vector<nlohmann::json> requestJsonAnswers(answers.size());
-    for (int i = 0; i < answers.size(); i++) {
-        std::string request = "request" + (i < 100 ? (i < 10 ? "00" + std::to_string(i + 1) : "0" + std::to_string(i + 1)) : std::to_string(i + 1));
-        if (answers[i].empty()) {
-            (requestJsonAnswers[i])[request]["result"] = false;
-        } else if (answers[i].size() == 1) {
-            (requestJsonAnswers[i])[request]["result"] = true;
-            (requestJsonAnswers[i])[request]["docid"] = answers[i][0].first;
-            (requestJsonAnswers[i])[request]["rank"] = answers[i][0].second;
-        } else {
-            (requestJsonAnswers[i])[request]["result"] = true;
-            for (int j = 0; j < answers[i].size(); j++) {
-                nlohmann::json docRank;
-                docRank["docid"] = answers[i][j].first;
-                docRank["rank"] = answers[i][j].second;
-                (requestJsonAnswers[i])[request]["relevance"].push_back(docRank);
-            }
+nlohmann::json ConverterJSON::getAnswerJson(size_t i, const std::vector<std::pair<size_t, double>> &answer) {
+    nlohmann::json requestJsonAnswer;
+    std::string request = "request" + (i < 100 ? (i < 10 ? "00" + std::to_string(i + 1) : "0" + std::to_string(i + 1)) : std::to_string(i + 1));
+    if (answer.empty()) {
+        requestJsonAnswer[request]["result"] = false;
+    } else if (answer.size() == 1) {
+        requestJsonAnswer[request]["result"] = true;
+        requestJsonAnswer[request]["docid"] = answer[0].first;
+        requestJsonAnswer[request]["rank"] = answer[0].second;
+    } else {
+        requestJsonAnswer[request]["result"] = true;
+        for (size_t j = 0; j < answer.size(); j++) {
+            nlohmann::json docRank;
+            docRank["docid"] = answer[j].first;
+            docRank["rank"] = answer[j].second;
+            requestJsonAnswer[request]["relevance"].push_back(docRank);
         }
     }
+    return requestJsonAnswer;
+}
+
+nlohmann::json ConverterJSON::getAnswersJson(const std::vector<std::vector<std::pair<size_t, double>>> &answers) {
     nlohmann::json jsonAnswers;
-    for (auto &requestJsonAnswer : requestJsonAnswers)
-        jsonAnswers["answers"].push_back(requestJsonAnswer);
-        JSON::answers = jsonAnswers;
+    for (size_t i = 0; i < answers.size(); i++)
+        jsonAnswers["answers"].push_back(getAnswerJson(i, answers[i]));
+    return jsonAnswers;
+}
+
+nlohmann::json ConverterJSON::getIndexStatsJson(const IndexMemoryStats &stats) {
+    auto getUsageJson = [](const MemoryUsage &usage) {
+        return nlohmann::json({{"allocated", usage.allocated}, {"mapped", usage.mapped}});
+    };
+    MemoryUsage total = stats.dictionary;
+    total += stats.postings;
+    total += stats.documents;
+
+    nlohmann::json json;
+    json["documents"] = stats.docsAmount;
+    json["segments"] = stats.segmentsNum;
+    json["vocabulary"] = stats.vocabularySize;
+    json["postings"] = stats.postingsNum;
+    json["raw_text_bytes"] = stats.rawTextBytes;
+    json["bytes"] = {{"dictionary", getUsageJson(stats.dictionary)}, {"postings", getUsageJson(stats.postings)},
+                     {"positions", getUsageJson(stats.positions)}, {"documents", getUsageJson(stats.documents)},
+                     {"total", getUsageJson(total)}};
+    for (size_t i = 0; i < (size_t) MemoryCategory::Count; i++) {
+        auto category = (MemoryCategory) i;
+        json["process_allocated_bytes"][MemoryAccounting::getName(category)] = {
+                {"current", MemoryAccounting::getAllocatedBytes(category)},
+                {"peak", MemoryAccounting::getPeakBytes(category)}};
+    }
+    json["doc_frequency_histogram"] = nlohmann::json::array();
+    for (size_t i = 0; i < stats.docFrequencyHistogram.size(); i++) {
+        json["doc_frequency_histogram"].push_back({{"min_docs", (size_t) 1 << i},
+                                                   {"max_docs", ((size_t) 2 << i) - 1},
+                                                   {"terms", stats.docFrequencyHistogram[i]}});
+    }
+    json["longest_postings"] = nlohmann::json::array();
+    for (auto &term : stats.longestPostings)
+        json["longest_postings"].push_back({{"term", term.term}, {"doc_frequency", term.docFrequency}});
+    return json;
+}
+
+status ConverterJSON::putAnswers(std::vector<std::vector<std::pair<size_t, double>>> answers) {
+    METRICS_TIME(MetricStage::WriteAnswers);
+    JSON::answers = getAnswersJson(answers);
 
     return FileExchange::writeToFile(JSON::answers, "answers.json");
 }
+
+status RequestsReader::open(const std::string &path) {
+    file.open(path);
+    lineNumber = 0;
+    if (!file.is_open()) {
+        std::cerr << "Can't open file: " << path << std::endl;
+        return status::ERROR;
+    }
+    return status::OK;
+}
+
+size_t RequestsReader::read(std::vector<std::string> &requests, size_t maxCount) {
+    requests.clear();
+    std::string line;
+    while (requests.size() < maxCount && std::getline(file, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+        if (request.is_object())
+            request = request["request"];
+        if (!request.is_string()) {
+            ///< The line keeps its number in the answers, it is answered as a request without words
+            std::cerr << "Line " << lineNumber << " is not a request, it is answered as an empty one" << std::endl;
+            request = "";
+        }
+        requests.push_back(request);
+    }
+    return requests.size();
+}
+
+AnswersWriter::~AnswersWriter() {
+    if (file.is_open())
+        close();
+}
+
+status AnswersWriter::open(const std::string &path) {
+    file.open(path, std::ios::trunc);
+    written = 0;
+    if (!file.is_open()) {
+        std::cerr << "Can't open file: " << path << std::endl;
+        return status::ERROR;
+    }
+    file << "{\"answers\":[";
+    return file ? status::OK : status::ERROR;
+}
+
+status AnswersWriter::write(const std::vector<std::pair<size_t, double>> &answer) {
+    if (written != 0)
+        file << ',';
+    file << ConverterJSON::getAnswerJson(written++, answer);
+    return file ? status::OK : status::ERROR;
+}
+
+status AnswersWriter::close() {
+    file << "]}";
+    file.close();
+    return file ? status::OK : status::ERROR;
+}
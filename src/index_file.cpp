@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <cstring>
+#include <fstream>
+#include "index_file.h"
+#include "posting_list.h"
+
+///< The sections are used in place, so the layout of the stored structures must not change unnoticed
+static_assert(sizeof(PostingBlock) == 24, "PostingBlock layout is a part of the index file format");
+static_assert(sizeof(TermInfo) == 24, "TermInfo layout is a part of the index file format");
+static_assert(sizeof(IndexFileHeader) == 32, "IndexFileHeader layout is a part of the index file format");
+static_assert(sizeof(IndexSectionRecord) == 24, "IndexSectionRecord layout is a part of the index file format");
+
+const uint32_t IndexFileWriter::version;
+
+namespace {
+const char indexMagic[8] = {'E', 'W', 'F', 'I', 'N', 'D', 'E', 'X'};
+const uint64_t byteOrderMark = 0x0102030405060708ull;
+const size_t sectionAlignment = 8;
+
+/*!
+ * Checksum of a byte stream processed by 8-byte words
+ */
+class Checksum {
+public:
+    void update(const void *data, size_t size) {
+        auto bytes = (const unsigned char *) data;
+        while (size > 0) {
+            size_t taken = std::min(size, sizeof(word) - filled);
+            std::memcpy(word + filled, bytes, taken);
+            filled += taken;
+            bytes += taken;
+            size -= taken;
+            if (filled == sizeof(word))
+                flushWord();
+        }
+    }
+
+    uint64_t result() {
+        if (filled != 0) {
+            std::memset(word + filled, 0, sizeof(word) - filled);
+            flushWord();
+        }
+        return value ^ (value >> 31);
+    }
+
+private:
+    uint64_t value = 0x243f6a8885a308d3ull;
+    unsigned char word[8] = {};
+    size_t filled = 0;
+
+    void flushWord() {
+        uint64_t next;
+        std::memcpy(&next, word, sizeof(next));
+        value = (value ^ next) * 0x9e3779b97f4a7c15ull;
+        value ^= value >> 29;
+        filled = 0;
+    }
+};
+
+size_t alignedSize(size_t size) {
+    return (size + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+}
+
+void IndexFileWriter::addSection(IndexSection id, const void *data, size_t size) {
+    sections.push_back({id, data, size, std::string()});
+}
+
+void IndexFileWriter::addSection(IndexSection id, const std::string &path) {
+    sections.push_back({id, nullptr, 0, path});
+}
+
+status IndexFileWriter::write(const std::string &path) const {
+    IndexFileHeader header{};
+    std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = version;
+    header.sectionsNum = (uint32_t) sections.size();
+    header.byteOrder = byteOrderMark;
+
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream file;
+    file.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+    try {
+        std::vector<IndexSectionRecord> table(sections.size());
+        uint64_t offset = sizeof(IndexFileHeader) + alignedSize(sizeof(IndexSectionRecord) * table.size());
+        for (size_t i = 0; i < sections.size(); i++) {
+            uint64_t size = sections[i].size;
+            if (!sections[i].path.empty()) {
+                std::ifstream sectionFile(sections[i].path, std::ios::binary | std::ios::ate);
+                if (!sectionFile.is_open())
+                    throw std::ofstream::failure("Can't open file: " + sections[i].path);
+                size = (uint64_t) sectionFile.tellg();
+            }
+            table[i].id = (uint32_t) sections[i].id;
+            table[i].offset = offset;
+            table[i].size = size;
+            offset += alignedSize(size);
+        }
+
+        ///< The checksum is counted while the sections are written, the header is written again at the end
+        const char padding[sectionAlignment] = {};
+        Checksum checksum;
+        auto writeBytes = [&file, &checksum] (const void *data, size_t size) {
+            file.write((const char *) data, (std::streamsize) size);
+            checksum.update(data, size);
+        };
+        file.open(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write((const char *) &header, sizeof(header));
+        writeBytes(table.data(), sizeof(IndexSectionRecord) * table.size());
+        std::vector<char> buffer;
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].path.empty()) {
+                writeBytes(sections[i].data, sections[i].size);
+            } else {
+                const size_t bufferSize = 1 << 20;
+                buffer.resize(bufferSize);
+                std::ifstream sectionFile(sections[i].path, std::ios::binary);
+                for (uint64_t left = table[i].size; left > 0;) {
+                    auto taken = (size_t) std::min<uint64_t>(left, bufferSize);
+                    if (!sectionFile.read(buffer.data(), (std::streamsize) taken))
+                        throw std::ofstream::failure("Can't read file: " + sections[i].path);
+                    writeBytes(buffer.data(), taken);
+                    left -= taken;
+                }
+            }
+            writeBytes(padding, alignedSize(table[i].size) - table[i].size);
+        }
+        header.checksum = checksum.result();
+        file.seekp(0);
+        file.write((const char *) &header, sizeof(header));
+        file.close();
+    }
+    catch (const std::ofstream::failure &ex) {
+        std::cerr << "Can't write to file: " << temporaryPath << std::endl;
+        if (file.is_open())
+            file.close();
+        std::remove(temporaryPath.c_str());
+        return status::ERROR;
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str()); ///< rename does not replace an existing file on Windows
+#endif
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Can't write to file: " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return status::ERROR;
+    }
+    return status::OK;
+}
+
+status IndexFileReader::open(const std::string &path, bool verify) {
+    sections.clear();
+    file = std::make_shared<MappedFile>();
+    if (file->open(path) != status::OK)
+        return status::ERROR;
+
+    IndexFileHeader header{};
+    if (file->size() < sizeof(header))
+        return status::ERROR;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0 || header.version != IndexFileWriter::version ||
+            header.byteOrder != byteOrderMark)
+        return status::ERROR;
+
+    size_t tableSize = sizeof(IndexSectionRecord) * header.sectionsNum;
+    if (file->size() - sizeof(header) < tableSize)
+        return status::ERROR;
+    sections.resize(header.sectionsNum);
+    std::memcpy(sections.data(), file->data() + sizeof(header), tableSize);
+    for (auto &section : sections) {
+        if (section.offset % sectionAlignment != 0 || section.offset > file->size() ||
+                section.size > file->size() - section.offset)
+            return status::ERROR;
+    }
+
+    if (verify) {
+        Checksum checksum;
+        checksum.update(file->data() + sizeof(header), file->size() - sizeof(header));
+        if (checksum.result() != header.checksum)
+            return status::ERROR;
+    }
+    return status::OK;
+}
+
+bool IndexFileReader::findSection(IndexSection id, const char *&data, size_t &size) const {
+    for (auto &section : sections) {
+        if (section.id == (uint32_t) id) {
+            data = file->data() + section.offset;
+            size = (size_t) section.size;
+            return true;
+        }
+    }
+    return false;
+}
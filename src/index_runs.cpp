@@ -0,0 +1,196 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include "index_runs.h"
+#include "index_file.h"
+#include "metrics.h"
+
+namespace {
+const size_t runBufferSize = 1 << 16; ///< read buffer of every run during the merge
+
+template<typename T>
+void writeValue(std::ostream &file, T value) {
+    file.write((const char *) &value, sizeof(value));
+}
+
+template<typename T>
+void readValue(std::istream &file, T &value) {
+    file.read((char *) &value, sizeof(value));
+}
+
+/*!
+ * A run read term by term. A run file is the number of terms, then for every term the length of the term,
+ * its characters, the number of its postings and the postings as pairs of docId and count.
+ * The stream throws on errors, so a missing or truncated run stops the merge.
+ */
+class RunReader {
+public:
+    std::string term; //!< the current term
+
+    explicit RunReader(const std::string &path) : buffer(runBufferSize) {
+        file.rdbuf()->pubsetbuf(buffer.data(), (std::streamsize) buffer.size());
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+        file.open(path, std::ios::binary);
+        readValue(file, termsLeft);
+    }
+
+/*!
+ * The method reads the next term, the postings of the current term must be read before.
+ * @return false if the run has no more terms
+ */
+    bool next() {
+        if (termsLeft == 0)
+            return false;
+        termsLeft--;
+        uint32_t size;
+        readValue(file, size);
+        term.resize(size);
+        if (size != 0)
+            file.read(&term[0], size);
+        readValue(file, entriesNum);
+        return true;
+    }
+
+/*!
+ * The method reads the postings of the current term.
+ * @param [in, out] entries the vector the postings are appended to
+ */
+    void readEntries(std::vector<Entry> &entries) {
+        encoded.resize(2 * (size_t) entriesNum);
+        file.read((char *) encoded.data(), (std::streamsize) (encoded.size() * sizeof(uint32_t)));
+        for (size_t i = 0; i < encoded.size(); i += 2)
+            entries.push_back({encoded[i], encoded[i + 1]});
+    }
+
+private:
+    std::vector<char> buffer;
+    std::ifstream file;
+    uint64_t termsLeft = 0;
+    uint32_t entriesNum = 0;
+    std::vector<uint32_t> encoded;
+};
+}
+
+IndexRuns::IndexRuns(const std::string &inPathPrefix) : pathPrefix(inPathPrefix) {}
+
+IndexRuns::~IndexRuns() {
+    for (auto &path : paths)
+        std::remove(path.c_str());
+}
+
+status IndexRuns::write(PartialDictionary &partial) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(access);
+        path = pathPrefix + std::to_string(paths.size());
+        paths.push_back(path);
+    }
+
+    status result = status::OK;
+    std::ofstream file;
+    file.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+    try {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        writeValue(file, (uint64_t) partial.terms.size());
+        std::vector<Entry> entries;
+        std::vector<uint32_t> encoded;
+        for (uint32_t termId : partial.terms.getSortedIds()) {
+            entries.clear();
+            partial.postings.appendTo(termId, entries);
+            ///< A thread may get the blocks of the documents out of order, the run is sorted by docId
+            sortEntries(entries);
+            encoded.clear();
+            for (auto &entry : entries) {
+                encoded.push_back((uint32_t) entry.docId);
+                encoded.push_back((uint32_t) entry.count);
+            }
+            TextView term = partial.terms.getTermView(termId);
+            writeValue(file, (uint32_t) term.size);
+            file.write(term.data, (std::streamsize) term.size);
+            writeValue(file, (uint32_t) entries.size());
+            file.write((const char *) encoded.data(), (std::streamsize) (encoded.size() * sizeof(uint32_t)));
+        }
+        file.close();
+    }
+    catch (const std::ofstream::failure &ex) {
+        std::cerr << "Can't write to file: " << path << std::endl;
+        std::lock_guard<std::mutex> lock(access);
+        isFailed = true;
+        result = status::ERROR;
+    }
+    ///< The memory of the partial dictionary is freed, not only emptied, so the thread starts the next run from zero
+    partial = PartialDictionary();
+    return result;
+}
+
+size_t IndexRuns::size() const {
+    std::lock_guard<std::mutex> lock(access);
+    return paths.size();
+}
+
+status IndexRuns::merge(const std::string &path, const std::vector<char> &documents) {
+    METRICS_TIME(MetricStage::Merge);
+    if (isFailed)
+        return status::ERROR;
+    std::string docBytesPath = path + ".docs";
+    std::string countBytesPath = path + ".counts";
+    status result = status::OK;
+    try {
+        std::vector<std::unique_ptr<RunReader>> readers;
+        ///< The heap keeps the runs ordered by their current terms, the smallest term on top
+        auto isLater = [&readers] (size_t a, size_t b) {
+            int order = readers[a]->term.compare(readers[b]->term);
+            return order > 0 || (order == 0 && a > b);
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(isLater)> heap(isLater);
+        for (auto &runPath : paths) {
+            readers.emplace_back(new RunReader(runPath));
+            if (readers.back()->next())
+                heap.push(readers.size() - 1);
+        }
+
+        std::ofstream docFile, countFile;
+        docFile.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        countFile.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        docFile.open(docBytesPath, std::ios::binary | std::ios::trunc);
+        countFile.open(countBytesPath, std::ios::binary | std::ios::trunc);
+        ///< Terms get ids in alphabetical order like in mergePartialDictionaries, so the file is the same
+        TermDictionary terms;
+        PostingStore postings;
+        std::vector<Entry> entries;
+        std::string term;
+        while (!heap.empty()) {
+            term = readers[heap.top()]->term;
+            entries.clear();
+            while (!heap.empty() && readers[heap.top()]->term == term) {
+                size_t run = heap.top();
+                heap.pop();
+                readers[run]->readEntries(entries);
+                if (readers[run]->next())
+                    heap.push(run);
+            }
+            ///< Several runs may hold postings of one document if its blocks went to different threads
+            sortEntries(entries);
+            terms.insert(term);
+            postings.append(entries);
+            postings.moveBytesTo(docFile, countFile);
+        }
+        docFile.close();
+        countFile.close();
+
+        IndexFileWriter writer;
+        terms.writeTo(writer);
+        postings.writeTo(writer, docBytesPath, countBytesPath);
+        writer.addSection(IndexSection::Documents, documents.data(), documents.size());
+        result = writer.write(path);
+    }
+    catch (const std::ios_base::failure &ex) {
+        std::cerr << "Can't merge the runs into file: " << path << std::endl;
+        result = status::ERROR;
+    }
+    std::remove(docBytesPath.c_str());
+    std::remove(countBytesPath.c_str());
+    return result;
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include "ingest_pipeline.h"
+#include "file_exchange.h"
+#include "metrics.h"
+#include "tokenizer.h"
+
+namespace {
+const size_t defaultReaders = 2;
+const size_t defaultQueueDepth = 16;
+const size_t defaultBlockSize = 1 << 20;
+
+typedef std::chrono::steady_clock clock_type;
+
+double secondsSince(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+size_t getHalfOfHardwareThreads() {
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads / 2 : 1;
+}
+
+/*!
+ * The function sums up the statistics of the threads of one stage
+ * @param [in] name name of the stage
+ * @param [in] threadStats statistics of every thread
+ * @return statistics of the stage
+ */
+StageStats sumStageStats(const char *name, const std::vector<StageStats> &threadStats) {
+    StageStats stage;
+    stage.name = name;
+    stage.threads = threadStats.size();
+    for (auto &thread : threadStats) {
+        stage.blocks += thread.blocks;
+        stage.bytes += thread.bytes;
+        stage.busySeconds += thread.busySeconds;
+    }
+    return stage;
+}
+}
+
+IngestPipeline::IngestPipeline(const IngestSettings &inSettings) : settings(inSettings) {
+    if (settings.readers == 0)
+        settings.readers = defaultReaders;
+    if (settings.tokenizers == 0)
+        settings.tokenizers = getHalfOfHardwareThreads();
+    if (settings.indexers == 0)
+        settings.indexers = getHalfOfHardwareThreads();
+    if (settings.queueDepth == 0)
+        settings.queueDepth = defaultQueueDepth;
+    if (settings.blockSize == 0)
+        settings.blockSize = defaultBlockSize;
+}
+
+void IngestPipeline::run(const std::vector<std::string> &paths, InvertedIndex &index) {
+    METRICS_TIME(MetricStage::Index);
+    auto start = clock_type::now();
+    std::vector<PartialDictionary> partials(settings.indexers);
+    std::vector<BlockStart> blockStarts;
+    runStages(paths, index.isLowercase(), index.hasPositions(), partials, nullptr, blockStarts);
+    index.updateDocumentBase(partials, stats.docsAmount, &blockStarts);
+    stats.seconds = secondsSince(start);
+}
+
+status IngestPipeline::run(const std::vector<std::string> &paths, InvertedIndex &index, const std::string &indexPath) {
+    if (index.hasPositions()) {
+        ///< The sources are cleared by the new base, they are kept for the file
+        std::vector<DocumentSource> sources = index.getSources();
+        run(paths, index);
+        index.setSources(sources);
+        return index.save(indexPath);
+    }
+    METRICS_TIME(MetricStage::Index);
+    auto start = clock_type::now();
+    std::vector<PartialDictionary> partials(settings.indexers);
+    std::vector<BlockStart> blockStarts;
+    IndexRuns runs(indexPath + ".run");
+    runStages(paths, index.isLowercase(), false, partials, &runs, blockStarts);
+    ///< The postings left in memory become the last runs, so the merge reads all the postings from the runs
+    for (auto &partial : partials) {
+        if (partial.terms.size() != 0)
+            runs.write(partial);
+    }
+    stats.runsNum = runs.size();
+    status result = index.updateDocumentBase(runs, stats.docsAmount, indexPath);
+    stats.seconds = secondsSince(start);
+    return result;
+}
+
+void IngestPipeline::runStages(const std::vector<std::string> &paths, bool lowercase, bool positions,
+                               std::vector<PartialDictionary> &partials, IndexRuns *runs,
+                               std::vector<BlockStart> &blockStarts) {
+    stats = IngestStats();
+
+    ///< The files are only opened before the stages start, so the docIds skip the files that can't be opened
+    ///< like getTextDocuments does. A file is mapped by the reader that takes it, so only the files being
+    ///< read are mapped at a time, however many files there are.
+    std::vector<std::string> files;
+    for (auto &path : paths) {
+        if (FileExchange::canOpen(path))
+            files.push_back(path);
+    }
+    stats.docsAmount = files.size();
+
+    BoundedQueue<TextBlock> blocks(settings.queueDepth);
+    BoundedQueue<TokenizedBlock> tokenized(settings.queueDepth);
+    std::vector<StageStats> readerStats(settings.readers);
+    std::vector<StageStats> tokenizerStats(settings.tokenizers);
+    std::vector<StageStats> indexerStats(settings.indexers);
+    std::atomic<size_t> nextFile(0);
+    std::atomic<uint32_t> nextBlock(0);
+    std::vector<std::vector<BlockWords>> indexerBlocks(settings.indexers);
+    std::atomic<size_t> activeReaders(settings.readers);
+    std::atomic<size_t> activeTokenizers(settings.tokenizers);
+    ///< Every indexer gets an equal share of the budget, the blocks in the queues are not counted
+    size_t indexerBudget = settings.memoryBudget / settings.indexers;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < settings.readers; i++) {
+        threads.emplace_back([&, i]() {
+            readFiles(files, nextFile, nextBlock, blocks, readerStats[i]);
+            ///< The last reader to finish tells the tokenizers that no more blocks will come
+            if (--activeReaders == 0)
+                blocks.close();
+        });
+    }
+    for (size_t i = 0; i < settings.tokenizers; i++) {
+        threads.emplace_back([&, i]() {
+            tokenizeBlocks(blocks, tokenized, lowercase, positions, tokenizerStats[i]);
+            if (--activeTokenizers == 0)
+                tokenized.close();
+        });
+    }
+    for (size_t i = 0; i < settings.indexers; i++) {
+        threads.emplace_back([&, i]() {
+            indexBlocks(tokenized, partials[i], runs, indexerBudget, indexerBlocks[i], indexerStats[i]);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    stats.stages.push_back(sumStageStats("read", readerStats));
+    stats.stages.push_back(sumStageStats("tokenize", tokenizerStats));
+    stats.stages.push_back(sumStageStats("index", indexerStats));
+    stats.readQueue = blocks.getStats();
+    stats.tokenQueue = tokenized.getStats();
+
+    if (!positions)
+        return;
+    ///< The blocks of a file are numbered in their order, so ordering all the blocks by number orders every file
+    std::vector<uint32_t> blockDocIds(nextBlock), wordsNums(nextBlock);
+    for (auto &threadBlocks : indexerBlocks) {
+        for (auto &block : threadBlocks) {
+            blockDocIds[block.blockId] = block.docId;
+            wordsNums[block.blockId] = block.wordsNum;
+        }
+    }
+    blockStarts = getBlockStarts(blockDocIds, wordsNums);
+}
+
+void IngestPipeline::readFiles(const std::vector<std::string> &files, std::atomic<size_t> &nextFile,
+                               std::atomic<uint32_t> &nextBlock, BoundedQueue<TextBlock> &blocks,
+                               StageStats &stage) const {
+    for (size_t docId = nextFile++; docId < files.size(); docId = nextFile++) {
+        ///< The blocks share the mapping, so the file is unmapped as soon as its last block is tokenized.
+        ///< A file that can't be mapped any more keeps its docId and stays an empty document.
+        std::shared_ptr<MappedFile> file = FileExchange::mapTextFile(files[docId]);
+        if (!file)
+            continue;
+        const char *text = file->data();
+        size_t size = file->size();
+        size_t begin = 0;
+        while (begin < size) {
+            auto blockStart = clock_type::now();
+            ///< A block is extended to the end of the word it cuts, so every word stays in one block
+            size_t end = std::min(size, begin + settings.blockSize);
+            while (end < size && !Tokenizer::isDelimiter(text[end]))
+                end++;
+            ///< The pages of the block are read ahead while it waits in the queue, so the tokenizers find them loaded
+            file->willNeed(begin, end - begin);
+
+            stage.blocks++;
+            stage.bytes += end - begin;
+            METRICS_ADD(MetricCounter::BytesRead, end - begin);
+            stage.busySeconds += secondsSince(blockStart);
+            METRICS_ADD_BUSY_TIME(clock_type::now() - blockStart);
+            METRICS_ADD_TIME(MetricStage::ReadBlock, clock_type::now() - blockStart);
+            blocks.push({docId, nextBlock++, TextView(text + begin, end - begin), file});
+            begin = end;
+        }
+    }
+}
+
+void IngestPipeline::tokenizeBlocks(BoundedQueue<TextBlock> &blocks, BoundedQueue<TokenizedBlock> &tokenized,
+                                    bool lowercase, bool positions, StageStats &stage) {
+    TextBlock block;
+    while (blocks.pop(block)) {
+        auto blockStart = clock_type::now();
+        TokenizedBlock result;
+        result.docId = block.docId;
+        result.blockId = block.blockId;
+        result.bytes = block.text.size;
+        Tokenizer tokenizer(block.text, lowercase);
+        TextView word;
+        while (tokenizer.next(word)) {
+            uint32_t wordId = result.words.insert(word.data, word.size);
+            if (wordId == result.counts.size())
+                result.counts.push_back(0);
+            result.counts[wordId]++;
+            if (positions)
+                result.tokens.push_back(wordId);
+        }
+        ///< The words are copied into the dictionary of the block, the mapping may be released
+        block.file.reset();
+
+        stage.blocks++;
+        stage.bytes += result.bytes;
+        stage.busySeconds += secondsSince(blockStart);
+        METRICS_ADD_BUSY_TIME(clock_type::now() - blockStart);
+        tokenized.push(std::move(result));
+    }
+}
+
+void IngestPipeline::indexBlocks(BoundedQueue<TokenizedBlock> &tokenized, PartialDictionary &partial,
+                                 IndexRuns *runs, size_t budget, std::vector<BlockWords> &blockWords,
+                                 StageStats &stage) {
+    TokenizedBlock block;
+    std::vector<uint32_t> termIds;
+    while (tokenized.pop(block)) {
+        auto blockStart = clock_type::now();
+        if (!block.tokens.empty()) {
+            ///< The words are numbered within the block, the block is placed in its document after the run
+            termIds.resize(block.words.size());
+            for (uint32_t wordId = 0; wordId < block.words.size(); wordId++) {
+                TextView word = block.words.getTermView(wordId);
+                termIds[wordId] = partial.terms.insert(word.data, word.size);
+            }
+            for (uint32_t position = 0; position < block.tokens.size(); position++)
+                partial.postings.addOccurrence(termIds[block.tokens[position]], {block.blockId, position});
+            blockWords.push_back({block.blockId, (uint32_t) block.docId, (uint32_t) block.tokens.size()});
+        } else {
+            for (uint32_t wordId = 0; wordId < block.words.size(); wordId++) {
+                TextView word = block.words.getTermView(wordId);
+                uint32_t termId = partial.terms.insert(word.data, word.size);
+                ///< The blocks of a document usually come one after another, the rest is summed up by the merge
+                partial.postings.add(termId, (uint32_t) block.docId, block.counts[wordId]);
+            }
+        }
+        if (runs != nullptr &&
+                partial.terms.getMemoryUsage().allocated + partial.postings.getMemoryUsage().allocated > budget)
+            runs->write(partial);
+
+        stage.blocks++;
+        stage.bytes += block.bytes;
+        stage.busySeconds += secondsSince(blockStart);
+        METRICS_ADD_BUSY_TIME(clock_type::now() - blockStart);
+    }
+}
+
+void IngestPipeline::printStats(std::ostream &out) const {
+    out << "Ingestion: " << stats.docsAmount << " documents in " << std::fixed << std::setprecision(3)
+        << stats.seconds << " s" << std::endl;
+    for (auto &stage : stats.stages) {
+        double megabytes = (double) stage.bytes / (1 << 20);
+        out << "  " << std::left << std::setw(9) << stage.name << std::right << stage.threads << " threads, "
+            << stage.blocks << " blocks, " << std::setprecision(1) << megabytes << " MB, busy "
+            << std::setprecision(3) << stage.busySeconds << " s";
+        if (stage.busySeconds > 0)
+            out << ", " << std::setprecision(1) << megabytes / stage.busySeconds << " MB/s per thread";
+        out << std::endl;
+    }
+    const std::pair<const char *, const QueueStats *> queues[] = {{"read -> tokenize", &stats.readQueue},
+                                                                 {"tokenize -> index", &stats.tokenQueue}};
+    for (auto &queue : queues) {
+        const QueueStats &queueStats = *queue.second;
+        out << "  queue " << queue.first << ": capacity " << queueStats.capacity << ", max depth "
+            << queueStats.maxDepth << ", average depth " << std::setprecision(1)
+            << (queueStats.pushes != 0 ? (double) queueStats.depthSum / queueStats.pushes : 0.0)
+            << ", full waits " << queueStats.fullWaits << ", empty waits " << queueStats.emptyWaits << std::endl;
+    }
+    if (stats.runsNum != 0)
+        out << "  runs written to disk: " << stats.runsNum << std::endl;
+    out.unsetf(std::ios_base::floatfield);
+}
@@ -2,127 +2,611 @@
 // Created by Mihail on 14.03.2023.
 //
 
-#include <thread>
-#include <mutex>
+#include <algorithm>
 #include <cassert>
-#include <sstream>
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <unordered_map>
 #include "inverted_index.h"
+#include "metrics.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+
+const uint32_t InvertedIndex::npos;
+const size_t InvertedIndex::mergeFactor;
+const size_t InvertedIndex::minChunkSize;
+const size_t InvertedIndex::chunksPerThread;
 
 InvertedIndex::InvertedIndex() = default;
 
-std::vector<std::vector<size_t>> InvertedIndex::getGroupsOfElements(size_t amount, int groups) {
-    assert (amount > 0 && groups > 0);
-    std::vector<std::vector<size_t>> result;
-    if (amount < groups)
-        groups = (int) amount;
+namespace {
+const uint32_t lowercaseFlag = 1; ///< flag of the documents section: the words are turned to lowercase
+const uint32_t positionsFlag = 2; ///< flag of the documents section: the positions of the words are indexed
 
-    result.resize(groups);
+template<typename T>
+void writeValue(std::vector<char> &bytes, T value) {
+    const char *begin = (const char *) &value;
+    bytes.insert(bytes.end(), begin, begin + sizeof(value));
+}
 
-    int i = 0;
-    for(size_t j = 0; j < amount; j++) {
-        result[i].push_back(j);
-        if (++i == groups)
-            i = 0;
-    }
+template<typename T>
+bool readValue(const char *&data, const char *end, T &value) {
+    if ((size_t) (end - data) < sizeof(value))
+        return false;
+    std::memcpy(&value, data, sizeof(value));
+    data += sizeof(value);
+    return true;
+}
+}
 
-    return result;
+std::vector<InvertedIndex::TextChunk> InvertedIndex::getChunks(const std::vector<TextView> &inputDocs,
+                                                               size_t chunkSize) {
+    assert (chunkSize > 0);
+    std::vector<TextChunk> chunks;
+    for (size_t docId = 0; docId < inputDocs.size(); docId++) {
+        const TextView &text = inputDocs[docId];
+        size_t begin = 0;
+        while (text.size - begin > chunkSize) {
+            ///< The chunk is extended to the end of the word it cuts, so every word stays in one chunk
+            size_t end = begin + chunkSize;
+            while (end < text.size && !Tokenizer::isDelimiter(text.data[end]))
+                end++;
+            chunks.push_back({docId, begin, end, 0});
+            begin = end;
+        }
+        chunks.push_back({docId, begin, text.size, 0});
+    }
+    return chunks;
 }
 
 void InvertedIndex::updateDocumentBase(const std::vector<std::string>& inputDocs) {
+    updateDocumentBaseViews(std::vector<TextView>(inputDocs.begin(), inputDocs.end()));
+}
+
+void InvertedIndex::updateDocumentBaseViews(const std::vector<TextView> &inputDocs) {
+    METRICS_TIME(MetricStage::Index);
     assert (!inputDocs.empty());
-    docs = inputDocs;
-    freqDictionary.clear();
+    assert (inputDocs.size() < UINT32_MAX);
+    std::vector<uint32_t> docIds(inputDocs.size());
+    for (size_t docId = 0; docId < docIds.size(); docId++)
+        docIds[docId] = (uint32_t) docId;
+    replaceSegments(buildSegment(docIds, inputDocs, lowercase, positions));
+}
 
-    fillDictionaryByWords();
+void InvertedIndex::updateDocumentBase(std::vector<PartialDictionary> &partials, size_t docsAmount,
+                                       const std::vector<BlockStart> *blockStarts) {
+    assert (docsAmount < UINT32_MAX);
+    assert (!positions || blockStarts != nullptr);
+    auto segment = std::make_shared<IndexSegment>();
+    segment->docIds.resize(docsAmount);
+    for (size_t docId = 0; docId < docsAmount; docId++)
+        segment->docIds[docId] = (uint32_t) docId;
+    mergePartialDictionaries(partials, positions, blockStarts, *segment);
+    replaceSegments(segment);
+}
+
+status InvertedIndex::updateDocumentBase(IndexRuns &runs, size_t docsAmount, const std::string &path) {
+    assert (docsAmount < UINT32_MAX);
+    if (runs.merge(path, encodeDocuments(docsAmount)) != status::OK)
+        return status::ERROR;
+    return load(path);
+}
 
-    for (auto &it : freqDictionary) {
-       it.second = getWordCount(it.first);
+void InvertedIndex::replaceSegments(std::shared_ptr<IndexSegment> segment) {
+    merge.reset(); ///< a running merge works on the old segments, its result is not needed
+    sources.clear();
+    segment->id = nextSegmentId++;
+    docSegments.assign(segment->docIds.size(), segment->id);
+    segments.clear();
+    segments.push_back({std::move(segment), 0});
+}
+
+void InvertedIndex::updateDocuments(const std::vector<size_t> &docIds, const std::vector<std::string> &inputDocs) {
+    updateDocumentViews(docIds, std::vector<TextView>(inputDocs.begin(), inputDocs.end()));
+}
+
+void InvertedIndex::updateDocumentViews(const std::vector<size_t> &docIds, const std::vector<TextView> &inputDocs) {
+    assert (docIds.size() == inputDocs.size());
+    finishMerge(false);
+    if (docIds.empty())
+        return;
+
+    ///< The segment needs the documents in increasing order of id, of several versions of one document the last wins
+    std::vector<size_t> order(docIds.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&docIds] (size_t a, size_t b) {
+        return docIds[a] < docIds[b];
+    });
+    std::vector<uint32_t> batchIds;
+    std::vector<TextView> batchDocs;
+    for (size_t i : order) {
+        assert (docIds[i] < UINT32_MAX);
+        if (!batchIds.empty() && batchIds.back() == docIds[i]) {
+            batchDocs.back() = inputDocs[i];
+        } else {
+            batchIds.push_back((uint32_t) docIds[i]);
+            batchDocs.push_back(inputDocs[i]);
+        }
     }
+
+    auto segment = buildSegment(batchIds, batchDocs, lowercase, positions);
+    segment->id = nextSegmentId++;
+    addSegment(segment);
+    scheduleMerge();
 }
 
+void InvertedIndex::removeDocuments(const std::vector<size_t> &docIds) {
+    finishMerge(false);
+    for (size_t docId : docIds) {
+        if (docId < docSegments.size())
+            deleteDocument((uint32_t) docId);
+    }
+    scheduleMerge();
+}
 
-std::vector<Entry> InvertedIndex::getWordCount(const std::string &word) {
-    std::vector<Entry> result;
-    std::mutex resultAccess;
-    ///< hardwareThreadsNum is equal to the number of threads that can be created on this PC
-    int hardwareThreadsNum = std::thread::hardware_concurrency() != 0 ? (int) std::thread::hardware_concurrency() : 1;
-    auto docGroups = getGroupsOfElements(docs.size(), hardwareThreadsNum);
-    std::vector<std::thread> threads(docGroups.size());
-
-    for(int i = 0; i < threads.size(); i++) {
-        threads[i] = std::thread([i, &docGroups, this, &word, &result, &resultAccess]() {
-            for (size_t docId : docGroups[i]) {
-                Entry entry{};
-                entry.docId = docId;
-                entry.count = getCount(docs[docId], word);
-
-                if (entry.count != 0) {
-                    resultAccess.lock();
-                    result.push_back(entry);
-                    resultAccess.unlock();
+void InvertedIndex::waitForMerges() {
+    while (merge) {
+        finishMerge(true);
+        scheduleMerge();
+    }
+}
+
+std::shared_ptr<IndexSegment> InvertedIndex::buildSegment(const std::vector<uint32_t> &docIds,
+                                                          const std::vector<TextView> &inputDocs, bool lowercase,
+                                                          bool positions) {
+    auto segment = std::make_shared<IndexSegment>();
+    segment->docIds = docIds;
+
+    ThreadPool &pool = ThreadPool::shared();
+    size_t slotsNum = pool.getThreadsNumber() + 1;
+    size_t totalSize = 0;
+    for (auto &doc : inputDocs)
+        totalSize += doc.size;
+    ///< Several chunks per thread let the threads that got easy chunks take more of them
+    auto chunks = getChunks(inputDocs, std::max(minChunkSize, totalSize / (slotsNum * chunksPerThread)));
+
+    std::vector<PartialDictionary> partialDictionaries(slotsNum);
+    std::atomic<size_t> nextChunk(0);
+    pool.parallelFor(slotsNum, [&inputDocs, &docIds, &chunks, &partialDictionaries, &nextChunk, lowercase,
+                                positions](size_t slot) {
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++)
+            fillPartialDictionary(inputDocs, docIds, (uint32_t) i, chunks[i], lowercase, positions,
+                                  partialDictionaries[slot]);
+    });
+
+    if (!positions) {
+        mergePartialDictionaries(partialDictionaries, false, nullptr, *segment);
+        return segment;
+    }
+    ///< The words of every chunk are counted by now, so the chunks get their first positions in the documents
+    std::vector<uint32_t> chunkDocIds(chunks.size()), wordsNums(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        chunkDocIds[i] = docIds[chunks[i].docId];
+        wordsNums[i] = chunks[i].wordsNum;
+    }
+    std::vector<BlockStart> chunkStarts = getBlockStarts(chunkDocIds, wordsNums);
+    mergePartialDictionaries(partialDictionaries, true, &chunkStarts, *segment);
+    return segment;
+}
+
+std::shared_ptr<IndexSegment> InvertedIndex::mergeSegments(
+        const std::vector<std::shared_ptr<const IndexSegment>> &sources,
+        const std::vector<std::vector<uint32_t>> &liveDocs, uint32_t segmentId) {
+    METRICS_TIME(MetricStage::Merge);
+    auto segment = std::make_shared<IndexSegment>();
+    segment->id = segmentId;
+
+    std::vector<PartialDictionary> partials(sources.size());
+    ///< All the segments of an index have positions or none of them, a segment without terms has no arrays
+    bool positions = std::any_of(sources.begin(), sources.end(), [] (const std::shared_ptr<const IndexSegment> &a) {
+        return a->postings.hasPositions();
+    });
+    std::vector<uint32_t> wordPositions;
+    for (size_t i = 0; i < sources.size(); i++) {
+        const IndexSegment &source = *sources[i];
+        const std::vector<uint32_t> &live = liveDocs[i];
+        bool isAllLive = live.size() == source.docIds.size();
+        for (uint32_t termId = 0; termId < source.terms.size(); termId++) {
+            ///< A term is added only if some of its documents are live
+            uint32_t partialId = TermDictionary::npos;
+            for (PostingCursor cursor(source.postings.getPostings(termId)); !cursor.isEnd(); cursor.next()) {
+                if (!isAllLive && !std::binary_search(live.begin(), live.end(), cursor.docId()))
+                    continue;
+                if (partialId == TermDictionary::npos) {
+                    TextView term = source.terms.getTermView(termId);
+                    partialId = partials[i].terms.insert(term.data, term.size);
                 }
+                if (!positions) {
+                    partials[i].postings.add(partialId, cursor.docId(), cursor.count());
+                    continue;
+                }
+                cursor.getPositions(wordPositions);
+                for (uint32_t position : wordPositions)
+                    partials[i].postings.addOccurrence(partialId, {cursor.docId(), position});
             }
-        });
+        }
+
+        ///< Documents are live in one segment only, so the merged lists do not intersect
+        std::vector<uint32_t> docIds;
+        std::merge(segment->docIds.begin(), segment->docIds.end(), live.begin(), live.end(),
+                   std::back_inserter(docIds));
+        segment->docIds.swap(docIds);
     }
 
-    for (auto &thr : threads)
-        thr.join();
+    mergePartialDictionaries(partials, positions, nullptr, *segment);
+    return segment;
+}
 
-    return result;
+void InvertedIndex::addSegment(std::shared_ptr<const IndexSegment> segment) {
+    for (uint32_t docId : segment->docIds) {
+        deleteDocument(docId);
+        docSegments[docId] = segment->id;
+    }
+    segments.push_back({std::move(segment), 0});
 }
 
+void InvertedIndex::deleteDocument(uint32_t docId) {
+    if (docId >= docSegments.size()) {
+        docSegments.resize(docId + 1, npos);
+        return;
+    }
+    uint32_t segmentId = docSegments[docId];
+    if (segmentId == npos)
+        return;
+    docSegments[docId] = npos;
 
-void InvertedIndex::fillDictionaryByWords() {
-    std::mutex resultAccess;
-    ///< hardwareThreadsNum is equal to the number of threads that can be created on this PC
-    int hardwareThreadsNum = std::thread::hardware_concurrency() != 0 ? (int) std::thread::hardware_concurrency() : 1;
-    auto docGroups = getGroupsOfElements(docs.size(), hardwareThreadsNum);
-    std::vector<std::thread> threads(docGroups.size());
+    auto slot = std::find_if(segments.begin(), segments.end(), [segmentId] (const SegmentSlot &a) {
+        return a.segment->id == segmentId;
+    });
+    assert (slot != segments.end());
+    ///< A segment without live documents is dropped at once, there is nothing to merge
+    if (++slot->deletedNum == slot->segment->docIds.size())
+        segments.erase(slot);
+}
 
-    for(int i = 0; i < threads.size(); i++) {
-        threads[i] = std::thread([i, &docGroups, this, &resultAccess]() {
-            for (size_t docId : docGroups[i]) {
-                std::stringstream docStream(docs[docId]);
-                std::string word;
-                while(true) {
-                    docStream >> word;
-                    if (docStream.eof())
-                        break;
-                    if (freqDictionary.find(word) == freqDictionary.end()) {
-                        resultAccess.lock();
-                        freqDictionary.insert(std::pair<std::string, std::vector<Entry>>(word, 0));
-                        resultAccess.unlock();
-                    }
-                }
+std::vector<uint32_t> InvertedIndex::getLiveDocs(const SegmentSlot &slot) const {
+    if (slot.deletedNum == 0)
+        return slot.segment->docIds;
+    std::vector<uint32_t> live;
+    for (uint32_t docId : slot.segment->docIds) {
+        if (docSegments[docId] == slot.segment->id)
+            live.push_back(docId);
+    }
+    return live;
+}
+
+void InvertedIndex::scheduleMerge() {
+    if (merge)
+        return;
+
+    std::vector<size_t> chosen;
+    for (size_t i = 0; i < segments.size() && chosen.empty(); i++) {
+        if (segments[i].deletedNum * 2 > segments[i].segment->docIds.size())
+            chosen.push_back(i);
+    }
+    if (chosen.empty()) {
+        std::map<size_t, std::vector<size_t>> levels; ///< level -> segments whose live size is about mergeFactor^level
+        for (size_t i = 0; i < segments.size(); i++) {
+            size_t level = 0;
+            for (size_t live = segments[i].segment->docIds.size() - segments[i].deletedNum; live >= mergeFactor;
+                    live /= mergeFactor)
+                level++;
+            levels[level].push_back(i);
+        }
+        for (auto &level : levels) {
+            if (level.second.size() >= mergeFactor) {
+                chosen.assign(level.second.begin(), level.second.begin() + mergeFactor);
+                break;
             }
+        }
+    }
+    if (chosen.empty())
+        return;
+
+    auto pending = std::make_shared<PendingMerge>();
+    std::vector<std::shared_ptr<const IndexSegment>> mergedSegments;
+    std::vector<std::vector<uint32_t>> liveDocs;
+    for (size_t i : chosen) {
+        pending->sourceIds.push_back(segments[i].segment->id);
+        mergedSegments.push_back(segments[i].segment);
+        liveDocs.push_back(getLiveDocs(segments[i]));
+    }
+    uint32_t segmentId = nextSegmentId++;
+
+    ///< The merge reads only the immutable segments and its own copy of the live documents
+    auto task = std::make_shared<std::packaged_task<std::shared_ptr<const IndexSegment>()>>(
+            [mergedSegments = std::move(mergedSegments), liveDocs = std::move(liveDocs), segmentId] ()
+                    -> std::shared_ptr<const IndexSegment> {
+        return mergeSegments(mergedSegments, liveDocs, segmentId);
+    });
+    pending->result = task->get_future().share();
+    merge = pending;
+    ThreadPool::shared().submit([task] () { (*task)(); });
+}
+
+void InvertedIndex::finishMerge(bool wait) {
+    if (!merge)
+        return;
+    if (!wait && merge->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    std::shared_ptr<const IndexSegment> merged = merge->result.get();
+    std::vector<uint32_t> sourceIds = merge->sourceIds;
+    merge.reset();
+
+    ///< The documents removed or replaced while the merge was running stay deleted in the new segment
+    SegmentSlot mergedSlot{merged, 0};
+    for (uint32_t docId : merged->docIds) {
+        if (std::find(sourceIds.begin(), sourceIds.end(), docSegments[docId]) != sourceIds.end())
+            docSegments[docId] = merged->id;
+        else
+            mergedSlot.deletedNum++;
+    }
+    segments.erase(std::remove_if(segments.begin(), segments.end(), [&sourceIds] (const SegmentSlot &a) {
+        return std::find(sourceIds.begin(), sourceIds.end(), a.segment->id) != sourceIds.end();
+    }), segments.end());
+    if (mergedSlot.deletedNum < merged->docIds.size())
+        segments.push_back(mergedSlot);
+}
+
+std::vector<Entry> InvertedIndex::getWordCount(const std::string &word) {
+    std::vector<Entry> entries;
+    for (size_t i = 0; i < segments.size(); i++) {
+        for (PostingCursor cursor(getSegment(i).getPostings(word)); !cursor.isEnd(); cursor.next()) {
+            if (!hasDeletedDocs(i) || isLive(i, cursor.docId()))
+                entries.push_back({cursor.docId(), cursor.count()});
+        }
+    }
+    if (segments.size() > 1) {
+        std::sort(entries.begin(), entries.end(), [] (const Entry &a, const Entry &b) {
+            return a.docId < b.docId;
         });
     }
-    for (auto &thr : threads)
-        thr.join();
+    return entries;
+}
+
+void InvertedIndex::fillPartialDictionary(const std::vector<TextView> &inputDocs,
+                                          const std::vector<uint32_t> &docIds, uint32_t chunkId, TextChunk &chunk,
+                                          bool lowercase, bool positions, PartialDictionary &partial) {
+    Tokenizer tokenizer(TextView(inputDocs[chunk.docId].data + chunk.begin, chunk.end - chunk.begin), lowercase);
+    uint32_t docId = docIds[chunk.docId];
+    TextView word;
+    if (positions) {
+        uint32_t position = 0;
+        for (; tokenizer.next(word); position++)
+            partial.postings.addOccurrence(partial.terms.insert(word.data, word.size), {chunkId, position});
+        chunk.wordsNum = position;
+        return;
+    }
+    while (tokenizer.next(word)) {
+        uint32_t termId = partial.terms.insert(word.data, word.size);
+        ///< Chunks are claimed in increasing order, so the previous chunk of the same document is the last entry
+        partial.postings.add(termId, docId, 1);
+    }
+}
+
+void InvertedIndex::mergePartialDictionaries(std::vector<PartialDictionary> &partials, bool positions,
+                                             const std::vector<BlockStart> *blockStarts, IndexSegment &segment) {
+    TermDictionary mergedTerms;
+    std::vector<std::vector<uint32_t>> mergedIds(partials.size()); ///< merged id of every term of every partial
+    for (size_t i = 0; i < partials.size(); i++) {
+        mergedIds[i].resize(partials[i].terms.size());
+        for (uint32_t termId = 0; termId < partials[i].terms.size(); termId++) {
+            TextView term = partials[i].terms.getTermView(termId);
+            mergedIds[i][termId] = mergedTerms.insert(term.data, term.size);
+        }
+    }
+
+    ///< The terms of the partials are grouped by merged id with a counting sort, so no list is made per term
+    std::vector<uint32_t> firstRef(mergedTerms.size() + 1, 0);
+    for (auto &ids : mergedIds) {
+        for (uint32_t id : ids)
+            firstRef[id + 1]++;
+    }
+    for (size_t id = 0; id < mergedTerms.size(); id++)
+        firstRef[id + 1] += firstRef[id];
+    std::vector<std::pair<uint32_t, uint32_t>> refs(firstRef.back()); ///< partial and term id in it
+    std::vector<uint32_t> nextRef(firstRef.begin(), firstRef.end() - 1);
+    for (uint32_t i = 0; i < mergedIds.size(); i++) {
+        for (uint32_t termId = 0; termId < mergedIds[i].size(); termId++)
+            refs[nextRef[mergedIds[i][termId]]++] = {i, termId};
+    }
+    std::vector<uint32_t>().swap(nextRef);
+    std::vector<std::vector<uint32_t>>().swap(mergedIds);
+
+    std::vector<Entry> entries; ///< reused by all the terms, so it grows only to the longest postings
+    std::vector<Occurrence> occurrences;
+    std::vector<uint32_t> wordPositions;
+    for (uint32_t id : mergedTerms.getSortedIds()) {
+        TextView term = mergedTerms.getTermView(id);
+        segment.terms.insert(term.data, term.size);
+        if (positions) {
+            occurrences.clear();
+            for (uint32_t ref = firstRef[id]; ref < firstRef[id + 1]; ref++)
+                partials[refs[ref].first].postings.appendTo(refs[ref].second, occurrences);
+            if (blockStarts != nullptr) {
+                for (auto &occurrence : occurrences) {
+                    const BlockStart &start = (*blockStarts)[occurrence.docId];
+                    occurrence = {start.docId, start.firstPosition + occurrence.position};
+                }
+            }
+            groupOccurrences(occurrences, entries, wordPositions);
+            segment.postings.append(entries, &wordPositions);
+            continue;
+        }
+        entries.clear();
+        for (uint32_t ref = firstRef[id]; ref < firstRef[id + 1]; ref++)
+            partials[refs[ref].first].postings.appendTo(refs[ref].second, entries);
+
+        ///< Every partial dictionary is ordered by docId, but the threads interleave, so the merged lists are sorted once.
+        ///< The chunks of one document may be counted by different threads, their entries are summed up.
+        sortEntries(entries);
+        segment.postings.append(entries);
+    }
+
+    ///< The pages of the partials are freed at once, the arrays of the segment keep only what they use
+    for (auto &partial : partials) {
+        partial.terms.clear();
+        partial.postings.clear();
+    }
+    segment.terms.shrinkToFit();
+    segment.postings.shrinkToFit();
+}
+
+size_t InvertedIndex::getDocsAmount() const {
+    return docSegments.size();
+}
+
+void InvertedIndex::setSources(const std::vector<DocumentSource> &inSources) {
+    sources = inSources;
 }
 
-size_t InvertedIndex::getCount(const std::string &text, const std::string &word) {
-    if (text.empty() || text.length() < word.length())
-        return 0;
+const std::vector<DocumentSource> &InvertedIndex::getSources() const {
+    return sources;
+}
+
+IndexMemoryStats InvertedIndex::getMemoryStats(size_t longestNum) const {
+    IndexMemoryStats stats;
+    stats.docsAmount = getDocsAmount();
+    stats.segmentsNum = segments.size();
+    for (auto &source : sources)
+        stats.rawTextBytes += source.size;
 
-    size_t counter = 0;
-    std::stringstream textStream(text + ' '); ///< The space is added to correctly check for eof
-    std::string wordFromText;
-    while(true) {
-        textStream >> wordFromText;
-        if (textStream.eof())
-            break;
-        if (wordFromText == word)
-            counter++;
+    std::unordered_map<std::string, size_t> docFrequencies;
+    for (auto &slot : segments) {
+        const IndexSegment &segment = *slot.segment;
+        stats.dictionary += segment.terms.getMemoryUsage();
+        stats.postings += segment.postings.getMemoryUsage();
+        stats.positions += segment.postings.getPositionsMemoryUsage();
+        stats.documents.allocated += segment.docIds.capacity() * sizeof(uint32_t);
+        for (uint32_t termId = 0; termId < segment.terms.size(); termId++) {
+            size_t docFrequency = segment.postings.getPostings(termId).docFrequency;
+            TextView term = segment.terms.getTermView(termId);
+            docFrequencies[std::string(term.data, term.size)] += docFrequency;
+            stats.postingsNum += docFrequency;
+        }
     }
+    stats.documents.allocated += docSegments.capacity() * sizeof(uint32_t) +
+                                 segments.capacity() * sizeof(SegmentSlot) +
+                                 sources.capacity() * sizeof(DocumentSource);
+    for (auto &source : sources)
+        stats.documents.allocated += source.path.capacity();
 
-    return counter;
+    stats.vocabularySize = docFrequencies.size();
+    std::vector<TermFrequency> terms;
+    terms.reserve(docFrequencies.size());
+    for (auto &term : docFrequencies) {
+        size_t bucket = 0;
+        while (term.second >> (bucket + 1) != 0)
+            bucket++;
+        if (stats.docFrequencyHistogram.size() <= bucket)
+            stats.docFrequencyHistogram.resize(bucket + 1);
+        stats.docFrequencyHistogram[bucket]++;
+        terms.push_back({term.first, term.second});
+    }
+    longestNum = std::min(longestNum, terms.size());
+    std::partial_sort(terms.begin(), terms.begin() + (std::ptrdiff_t) longestNum, terms.end(),
+                      [](const TermFrequency &a, const TermFrequency &b) {
+        return a.docFrequency > b.docFrequency || (a.docFrequency == b.docFrequency && a.term < b.term);
+    });
+    terms.resize(longestNum);
+    stats.longestPostings = std::move(terms);
+    return stats;
 }
 
-std::map<std::string, std::vector<Entry>> InvertedIndex::getFreqDictionary() {
-    return freqDictionary;
+status InvertedIndex::save(const std::string &path) const {
+    METRICS_TIME(MetricStage::SaveIndex);
+    std::shared_ptr<const IndexSegment> saved;
+    if (segments.size() == 1 && segments[0].deletedNum == 0) {
+        saved = segments[0].segment;
+    } else {
+        std::vector<std::shared_ptr<const IndexSegment>> savedSegments;
+        std::vector<std::vector<uint32_t>> liveDocs;
+        for (auto &slot : segments) {
+            savedSegments.push_back(slot.segment);
+            liveDocs.push_back(getLiveDocs(slot));
+        }
+        saved = mergeSegments(savedSegments, liveDocs, 0);
+    }
+
+    std::vector<char> documents = encodeDocuments(docSegments.size());
+    IndexFileWriter writer;
+    saved->terms.writeTo(writer);
+    saved->postings.writeTo(writer);
+    writer.addSection(IndexSection::Documents, documents.data(), documents.size());
+    return writer.write(path);
 }
 
-size_t InvertedIndex::getDocsAmount() {
-    return docs.size();
+status InvertedIndex::load(const std::string &path, bool verify) {
+    METRICS_TIME(MetricStage::LoadIndex);
+    IndexFileReader reader;
+    if (reader.open(path, verify) != status::OK)
+        return status::ERROR;
+
+    InvertedIndex loaded;
+    auto segment = std::make_shared<IndexSegment>();
+    const char *documents;
+    size_t documentsSize, docsAmount;
+    if (!reader.findSection(IndexSection::Documents, documents, documentsSize) ||
+            !loaded.decodeDocuments(documents, documentsSize, docsAmount) ||
+            !segment->terms.readFrom(reader) || !segment->postings.readFrom(reader, docsAmount) ||
+            segment->terms.size() != segment->postings.size() ||
+            (segment->terms.size() != 0 && segment->postings.hasPositions() != loaded.positions))
+        return status::ERROR;
+    segment->file = reader.getFile();
+
+    ///< The file holds one segment, the documents removed before saving simply have no postings in it
+    segment->id = loaded.nextSegmentId++;
+    segment->docIds.resize(docsAmount);
+    for (size_t docId = 0; docId < docsAmount; docId++)
+        segment->docIds[docId] = (uint32_t) docId;
+    loaded.docSegments.assign(docsAmount, segment->id);
+    if (docsAmount != 0)
+        loaded.segments.push_back({segment, 0});
+
+    *this = std::move(loaded);
+    return status::OK;
+}
+
+std::vector<char> InvertedIndex::encodeDocuments(size_t docsAmount) const {
+    ///< docsAmount, flags, number of sources, then the path length, path, size and modification time of every source
+    std::vector<char> bytes;
+    writeValue(bytes, (uint64_t) docsAmount);
+    writeValue(bytes, (uint32_t) ((lowercase ? lowercaseFlag : 0) | (positions ? positionsFlag : 0)));
+    writeValue(bytes, (uint64_t) sources.size());
+    for (auto &source : sources) {
+        writeValue(bytes, (uint32_t) source.path.size());
+        bytes.insert(bytes.end(), source.path.begin(), source.path.end());
+        writeValue(bytes, source.size);
+        writeValue(bytes, source.modified);
+    }
+    return bytes;
+}
+
+bool InvertedIndex::decodeDocuments(const char *data, size_t size, size_t &docsAmount) {
+    const char *end = data + size;
+    uint64_t amount, sourcesNum;
+    uint32_t flags;
+    if (!readValue(data, end, amount) || !readValue(data, end, flags) || !readValue(data, end, sourcesNum) ||
+            amount >= UINT32_MAX || (flags & ~(lowercaseFlag | positionsFlag)) != 0)
+        return false;
+    docsAmount = (size_t) amount;
+    lowercase = (flags & lowercaseFlag) != 0;
+    positions = (flags & positionsFlag) != 0;
+    sources.clear();
+    for (uint64_t i = 0; i < sourcesNum; i++) {
+        DocumentSource source;
+        uint32_t pathSize;
+        if (!readValue(data, end, pathSize) || (size_t) (end - data) < pathSize)
+            return false;
+        source.path.assign(data, pathSize);
+        data += pathSize;
+        if (!readValue(data, end, source.size) || !readValue(data, end, source.modified))
+            return false;
+        sources.push_back(source);
+    }
+    return data == end;
 }
\ No newline at end of file
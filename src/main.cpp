@@ -1,29 +1,240 @@
+#include <algorithm>
+#include <thread>
 #include "file_exchange.h"
 #include "converter_json.h"
 #include "search_server.h"
+#include "thread_pool.h"
+#include "ingest_pipeline.h"
+#include "query_daemon.h"
+#include "shard_coordinator.h"
+#include "metrics.h"
 
 void paused();
 
-int main() {
+void writeMetrics();
+
+std::shared_ptr<InvertedIndex> getIndex(const std::vector<DocumentSource> &sources, const std::string &indexPath);
+
+status answerRequestsFile(const QueryDaemon::search_function_t &search, const std::string &requestsPath,
+                          const std::string &answersPath);
+
+int serveShard(char *argv[]);
+
+/*!
+ * The application answers the requests of requests.json once. With --serve it keeps the index in memory
+ * and answers the lines of the standard input, with --socket <path> it answers the clients of a Unix domain socket.
+ * With --jsonl <requests> [<answers>] it answers the requests of a JSON Lines file, answers.json by default.
+ * With --index-stats it prints the sizes and the memory of the index instead of searching.
+ * --shard-worker <socket> <shard> <first> <end> is used by ShardCoordinator to start the process of a shard.
+ */
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    bool isValid = argc == 1 || (argc == 2 && mode == "--serve") || (argc == 3 && mode == "--socket") ||
+                   ((argc == 3 || argc == 4) && mode == "--jsonl") || (argc == 2 && mode == "--index-stats") ||
+                   (argc == 6 && mode == "--shard-worker");
+    if (!isValid) {
+        std::cerr << "Usage: " << argv[0] << " [--serve | --socket <path> | --jsonl <requests> [<answers>] | --index-stats]"
+                  << std::endl;
+        return 1;
+    }
+    ///< In --serve and --index-stats modes the standard output carries only the JSON, the startup messages go to the error stream
+    std::streambuf *output = std::cout.rdbuf();
+    if (mode == "--serve" || mode == "--index-stats" || mode == "--shard-worker")
+        std::cout.rdbuf(std::cerr.rdbuf());
+
     if (FileExchange::readFromFile(JSON::config, "config.json") != status::OK ||
             ConfigInit::checkCorrectConfig() != status::OK) {
+        if (mode == "--shard-worker")
+            return 1;
         paused();
         return 0;
     }
+    if (mode == "--shard-worker")
+        return serveShard(argv);
 
-    InvertedIndex invertedIndex;
-    invertedIndex.updateDocumentBase(ConverterJSON::getTextDocuments());
+    ThreadPool::shared().setThreadsNumber(ConverterJSON::getThreadsNumber(), ConverterJSON::isThreadsPinned());
 
-    SearchServer searchServer(invertedIndex);
-    auto searchResult = searchServer.search(ConverterJSON::getRequests());
+    auto sources = ConverterJSON::getDocumentSources();
+    std::unique_ptr<ShardCoordinator> coordinator;
+    std::shared_ptr<InvertedIndex> invertedIndex;
+    if (ConverterJSON::getShardsNumber() > 1 && mode != "--index-stats") {
+        coordinator.reset(new ShardCoordinator(argv[0], ConverterJSON::getShardsNumber()));
+        if (coordinator->start(sources) != status::OK)
+            return 1;
+    } else {
+        invertedIndex = getIndex(sources, ConverterJSON::getIndexPath());
+        if (invertedIndex == nullptr)
+            return 1;
+    }
 
-    if (ConverterJSON::putAnswers(SearchServer::convert(searchResult)) == status::OK)
-        std::cout << "\nSearching is done." << std::endl;
+    if (mode == "--index-stats") {
+        std::cout.rdbuf(output);
+        std::cout << ConverterJSON::getIndexStatsJson(invertedIndex->getMemoryStats()).dump(4) << std::endl;
+        return 0;
+    }
+
+    std::unique_ptr<SearchServer> searchServer;
+    QueryDaemon::search_function_t search;
+    if (coordinator != nullptr) {
+        search = [&coordinator](const std::vector<std::string> &requests) {
+            return coordinator->search(requests);
+        };
+    } else {
+        searchServer.reset(new SearchServer(invertedIndex));
+        search = [&searchServer](const std::vector<std::string> &requests) {
+            return searchServer->search(requests);
+        };
+    }
+    ///< The daemon of a single index also answers the statistics of its cache
+    auto makeDaemon = [&searchServer, &search]() {
+        return searchServer != nullptr ? std::unique_ptr<QueryDaemon>(new QueryDaemon(*searchServer))
+                                       : std::unique_ptr<QueryDaemon>(new QueryDaemon(search));
+    };
+
+    if (mode == "--serve") {
+        std::cout.rdbuf(output);
+        makeDaemon()->serveStdio();
+        writeMetrics();
+        return 0;
+    }
+    if (mode == "--socket") {
+        std::cerr << "Listening on " << argv[2] << std::endl;
+        return makeDaemon()->serveSocket(argv[2]) == status::OK ? 0 : 1;
+    }
+    try {
+        if (mode == "--jsonl") {
+            if (answerRequestsFile(search, argv[2], argc == 4 ? argv[3] : "answers.json") != status::OK)
+                return 1;
+            writeMetrics();
+            std::cout << "\nSearching is done." << std::endl;
+            return 0;
+        }
+        auto searchResult = search(ConverterJSON::getRequests());
+
+        if (ConverterJSON::putAnswers(SearchServer::convert(searchResult)) == status::OK)
+            std::cout << "\nSearching is done." << std::endl;
+    } catch (const std::runtime_error &e) {
+        std::cerr << "The requests are not answered: " << e.what() << std::endl;
+        return 1;
+    }
+    writeMetrics();
     paused();
     return 0;
 }
 
+/*!
+ * The function loads the index of the files or builds it if the index file is missing or out of date.
+ * @param [in] sources the files of the documents
+ * @param [in] indexPath path to the index file, empty if the index is not saved
+ * @return the index, nullptr if it can't be built
+ */
+std::shared_ptr<InvertedIndex> getIndex(const std::vector<DocumentSource> &sources, const std::string &indexPath) {
+    auto invertedIndex = std::make_shared<InvertedIndex>();
+    bool isIndexLoaded = !indexPath.empty() &&
+            invertedIndex->load(indexPath, ConverterJSON::isIndexVerified()) == status::OK &&
+            (!ConverterJSON::isIndexRebuiltIfChanged() || invertedIndex->getSources() == sources) &&
+            invertedIndex->isLowercase() == ConverterJSON::isLowercase() &&
+            invertedIndex->hasPositions() == ConverterJSON::isPositionsIndexed();
+    if (!isIndexLoaded) {
+        invertedIndex->setLowercase(ConverterJSON::isLowercase());
+        invertedIndex->setPositions(ConverterJSON::isPositionsIndexed());
+        ///< The files are read, tokenized and indexed at the same time, block by block
+        IngestSettings settings = ConverterJSON::getIngestSettings();
+        IngestPipeline pipeline(settings);
+        std::vector<std::string> paths;
+        for (auto &source : sources)
+            paths.push_back(source.path);
+        if (settings.memoryBudget != 0 && !indexPath.empty() && invertedIndex->hasPositions()) {
+            std::cerr << "The runs of ingest_memory_budget hold no positions, the index with positions is built "
+                         "in memory without the budget" << std::endl;
+        }
+        if (settings.memoryBudget != 0 && !indexPath.empty()) {
+            ///< The postings over the budget go to runs on disk, they are merged straight into the index file
+            invertedIndex->setSources(sources);
+            if (pipeline.run(paths, *invertedIndex, indexPath) != status::OK) {
+                std::cerr << "The index can't be built in " << indexPath << std::endl;
+                return nullptr;
+            }
+        } else {
+            pipeline.run(paths, *invertedIndex);
+            invertedIndex->setSources(sources);
+            if (!indexPath.empty() && invertedIndex->save(indexPath) != status::OK)
+                std::cerr << "The index is not saved, it will be built again on the next start" << std::endl;
+        }
+        if (ConverterJSON::isIngestStatsPrinted())
+            pipeline.printStats(std::cout);
+    }
+    return invertedIndex;
+}
+
+/*!
+ * The function serves one shard of the files for ShardCoordinator until the process is stopped.
+ * @param [in] argv the arguments: --shard-worker <socket> <shard> <first> <end>
+ * @return the exit code
+ */
+int serveShard(char *argv[]) {
+    size_t shard = std::stoul(argv[3]), first = std::stoul(argv[4]), end = std::stoul(argv[5]);
+    ///< The shards share the hardware threads unless the threads field sets the pool of every shard
+    size_t threadsNum = ConverterJSON::getThreadsNumber();
+    if (threadsNum == 0)
+        threadsNum = std::max<size_t>(1, std::thread::hardware_concurrency() /
+                                                 std::max<size_t>(1, ConverterJSON::getShardsNumber()));
+    ThreadPool::shared().setThreadsNumber(threadsNum, ConverterJSON::isThreadsPinned());
+
+    auto sources = ConverterJSON::getDocumentSources();
+    if (end > sources.size() || first >= end)
+        return 1;
+    std::string indexPath = ConverterJSON::getIndexPath();
+    if (!indexPath.empty())
+        indexPath += ".shard" + std::to_string(shard);
+    auto invertedIndex = getIndex(std::vector<DocumentSource>(sources.begin() + first, sources.begin() + end),
+                                  indexPath);
+    if (invertedIndex == nullptr)
+        return 1;
+    SearchServer searchServer(invertedIndex);
+    return QueryDaemon(searchServer).serveSocket(argv[2]) == status::OK ? 0 : 1;
+}
+
 void paused() {
     std::cout << "\nPress Enter to exit.";
     getchar(); //!< make pause for engine does not close immediately
-}
\ No newline at end of file
+}
+
+/*!
+ * The function writes the metrics to the file set by the metrics_path field of config.json,
+ * if the field is set and the metrics are compiled in.
+ */
+void writeMetrics() {
+    std::string metricsPath = ConverterJSON::getMetricsPath();
+    if (Metrics::isEnabled() && !metricsPath.empty() && Metrics::writeFile(metricsPath) != status::OK)
+        std::cerr << "The metrics are not written to " << metricsPath << std::endl;
+}
+
+/*!
+ * The function answers the requests of a JSON Lines file batch by batch. The answers of a batch are written
+ * as soon as it is searched, so the memory does not depend on the number of requests.
+ * @param [in] search the function answering a batch
+ * @param [in] requestsPath path to the requests file
+ * @param [in] answersPath path to the answers file
+ * @return operation status:
+ * OK - all the requests are answered;
+ * ERROR - an error occurred while reading or writing the files.
+ */
+status answerRequestsFile(const QueryDaemon::search_function_t &search, const std::string &requestsPath,
+                          const std::string &answersPath) {
+    const size_t batchSize = 4096; //!< enough requests to keep all the search threads busy
+    RequestsReader reader;
+    AnswersWriter writer;
+    if (reader.open(requestsPath) != status::OK || writer.open(answersPath) != status::OK)
+        return status::ERROR;
+    std::vector<std::string> requests;
+    while (reader.read(requests, batchSize) != 0) {
+        auto answers = SearchServer::convert(search(requests));
+        METRICS_TIME(MetricStage::WriteAnswers);
+        for (auto &answer : answers) {
+            if (writer.write(answer) != status::OK)
+                return status::ERROR;
+        }
+    }
+    return writer.close();
+}
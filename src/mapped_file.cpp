@@ -0,0 +1,101 @@
+#include <algorithm>
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+status MappedFile::open(const std::string &path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return status::ERROR;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return status::ERROR;
+    }
+    length = (size_t) fileSize.QuadPart;
+    if (length == 0) {
+        CloseHandle(file);
+        return status::OK;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        length = 0;
+        return status::ERROR;
+    }
+    begin = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (begin == nullptr) {
+        close();
+        return status::ERROR;
+    }
+    return status::OK;
+}
+
+void MappedFile::close() {
+    if (begin != nullptr)
+        UnmapViewOfFile(begin);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    begin = nullptr;
+    mapping = nullptr;
+    length = 0;
+}
+
+void MappedFile::willNeed(size_t offset, size_t size) const {}
+#else
+status MappedFile::open(const std::string &path) {
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return status::ERROR;
+    struct stat fileStat{};
+    if (fstat(file, &fileStat) != 0) {
+        ::close(file);
+        return status::ERROR;
+    }
+    length = (size_t) fileStat.st_size;
+    if (length == 0) {
+        ::close(file);
+        return status::OK;
+    }
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file); ///< the mapping keeps its own reference to the file
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        return status::ERROR;
+    }
+    begin = (const char *) mapped;
+    return status::OK;
+}
+
+void MappedFile::close() {
+    if (begin != nullptr)
+        munmap((void *) begin, length);
+    begin = nullptr;
+    length = 0;
+}
+
+void MappedFile::willNeed(size_t offset, size_t size) const {
+    if (begin == nullptr || offset >= length)
+        return;
+    ///< The range is widened to whole pages, the mapping itself starts on a page
+    static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t first = offset / pageSize * pageSize;
+    size_t end = std::min(length, offset + size);
+    posix_madvise((void *) (begin + first), end - first, POSIX_MADV_WILLNEED);
+}
+#endif
@@ -0,0 +1,33 @@
+#include <atomic>
+#include "memory_accounting.h"
+
+namespace {
+const size_t categoriesNum = (size_t) MemoryCategory::Count;
+const char *categoryNames[categoriesNum] = {"dictionary", "postings", "build"};
+
+std::atomic<size_t> allocatedBytes[categoriesNum] = {};
+std::atomic<size_t> peakBytes[categoriesNum] = {};
+}
+
+size_t MemoryAccounting::getAllocatedBytes(MemoryCategory category) {
+    return allocatedBytes[(size_t) category].load(std::memory_order_relaxed);
+}
+
+size_t MemoryAccounting::getPeakBytes(MemoryCategory category) {
+    return peakBytes[(size_t) category].load(std::memory_order_relaxed);
+}
+
+const char *MemoryAccounting::getName(MemoryCategory category) {
+    return categoryNames[(size_t) category];
+}
+
+void MemoryAccounting::allocated(MemoryCategory category, size_t bytes) {
+    auto i = (size_t) category;
+    size_t now = allocatedBytes[i].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peakBytes[i].load(std::memory_order_relaxed);
+    while (now > peak && !peakBytes[i].compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+}
+
+void MemoryAccounting::deallocated(MemoryCategory category, size_t bytes) {
+    allocatedBytes[(size_t) category].fetch_sub(bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,248 @@
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include "metrics.h"
+#include "file_exchange.h"
+
+const size_t StageMetrics::bucketsNum;
+
+namespace {
+const size_t stagesNum = (size_t) MetricStage::Count;
+const size_t countersNum = (size_t) MetricCounter::Count;
+const char *stageNames[stagesNum] = {"read_block", "index", "merge", "save_index", "load_index",
+                                     "search_batch", "query", "write_answers"};
+const char *counterNames[countersNum] = {"postings_scanned", "documents_scored", "bytes_read"};
+
+const Metrics::clock_type::time_point processStart = Metrics::clock_type::now();
+
+/*!
+ * The metrics of one thread. Only the owner thread writes them, so a value is updated by a relaxed load
+ * and store, and the readers see every value whole.
+ */
+struct ThreadBlock {
+    size_t thread = 0;
+    Metrics::clock_type::time_point started;
+    std::atomic<int64_t> finishedNs{-1};  ///< the end of the thread from processStart, -1 while it runs
+    std::atomic<uint64_t> calls[stagesNum] = {};
+    std::atomic<uint64_t> nanoseconds[stagesNum] = {};
+    std::atomic<uint64_t> buckets[stagesNum][StageMetrics::bucketsNum] = {};
+    std::atomic<uint64_t> counters[countersNum] = {};
+    std::atomic<uint64_t> busyNanoseconds{0};
+};
+
+/*!
+ * The blocks of all the threads. The registry is never destroyed, so the threads finishing after the end
+ * of main still find it.
+ */
+struct Registry {
+    std::mutex access;
+    std::vector<std::unique_ptr<ThreadBlock>> blocks;
+};
+
+Registry &getRegistry() {
+    static Registry *registry = new Registry;
+    return *registry;
+}
+
+/*!
+ * The block of the current thread, the end of the thread is recorded when it finishes
+ */
+struct BlockHolder {
+    ThreadBlock *block = nullptr;
+
+    ~BlockHolder() {
+        if (block != nullptr)
+            block->finishedNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Metrics::clock_type::now() - processStart).count(), std::memory_order_relaxed);
+    }
+};
+
+thread_local BlockHolder currentBlock;
+
+ThreadBlock &getBlock() {
+    if (currentBlock.block == nullptr) {
+        std::unique_ptr<ThreadBlock> block(new ThreadBlock);
+        block->started = Metrics::clock_type::now();
+        Registry &registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.access);
+        block->thread = registry.blocks.size();
+        currentBlock.block = block.get();
+        registry.blocks.push_back(std::move(block));
+    }
+    return *currentBlock.block;
+}
+
+inline void increase(std::atomic<uint64_t> &value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+double toSeconds(uint64_t nanoseconds) {
+    return (double) nanoseconds * 1e-9;
+}
+
+/*!
+ * The function returns the upper bound of a bucket of the histogram.
+ * @param [in] bucket the bucket
+ * @return the upper bound in seconds, 0 for the last bucket, which has no bound
+ */
+double getBucketBound(size_t bucket) {
+    return bucket + 1 < StageMetrics::bucketsNum ? (double) ((uint64_t) 1 << bucket) * 1e-6 : 0;
+}
+
+/*!
+ * The function estimates a quantile of the durations by the upper bound of the bucket that holds it.
+ * @param [in] stage the timings of the stage
+ * @param [in] quantile the quantile from 0 to 1
+ * @return the estimate in seconds
+ */
+double getQuantile(const StageMetrics &stage, double quantile) {
+    uint64_t rank = (uint64_t) (quantile * (double) stage.calls);
+    uint64_t passed = 0;
+    for (size_t i = 0; i < StageMetrics::bucketsNum; i++) {
+        passed += stage.buckets[i];
+        if (passed > rank)
+            return i + 1 < StageMetrics::bucketsNum ? getBucketBound(i) : getBucketBound(i - 1);
+    }
+    return 0;
+}
+}
+
+bool Metrics::isEnabled() {
+#ifdef SEARCH_ENGINE_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Metrics::addTime(MetricStage stage, uint64_t nanoseconds) {
+    ThreadBlock &block = getBlock();
+    size_t i = (size_t) stage;
+    size_t bucket = 0;
+    for (uint64_t microseconds = nanoseconds / 1000; microseconds != 0; microseconds >>= 1)
+        bucket++;
+    if (bucket >= StageMetrics::bucketsNum)
+        bucket = StageMetrics::bucketsNum - 1;
+    increase(block.calls[i], 1);
+    increase(block.nanoseconds[i], nanoseconds);
+    increase(block.buckets[i][bucket], 1);
+}
+
+void Metrics::add(MetricCounter counter, uint64_t value) {
+    increase(getBlock().counters[(size_t) counter], value);
+}
+
+void Metrics::addBusyTime(uint64_t nanoseconds) {
+    increase(getBlock().busyNanoseconds, nanoseconds);
+}
+
+MetricsSnapshot Metrics::collect() {
+    MetricsSnapshot snapshot;
+    auto now = clock_type::now();
+    snapshot.uptimeSeconds = std::chrono::duration<double>(now - processStart).count();
+    snapshot.stages.resize(stagesNum);
+    snapshot.counters.resize(countersNum);
+
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.access);
+    for (auto &block : registry.blocks) {
+        for (size_t i = 0; i < stagesNum; i++) {
+            StageMetrics &stage = snapshot.stages[i];
+            stage.calls += block->calls[i].load(std::memory_order_relaxed);
+            stage.nanoseconds += block->nanoseconds[i].load(std::memory_order_relaxed);
+            for (size_t j = 0; j < StageMetrics::bucketsNum; j++)
+                stage.buckets[j] += block->buckets[i][j].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < countersNum; i++)
+            snapshot.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+
+        uint64_t busy = block->busyNanoseconds.load(std::memory_order_relaxed);
+        if (busy == 0)
+            continue;
+        int64_t finishedNs = block->finishedNs.load(std::memory_order_relaxed);
+        auto finished = finishedNs < 0 ? now : processStart + std::chrono::nanoseconds(finishedNs);
+        ThreadMetrics thread;
+        thread.thread = block->thread;
+        thread.busySeconds = toSeconds(busy);
+        thread.aliveSeconds = std::chrono::duration<double>(finished - block->started).count();
+        snapshot.threads.push_back(thread);
+    }
+    return snapshot;
+}
+
+std::string Metrics::getPrometheusText() {
+    MetricsSnapshot snapshot = collect();
+    std::ostringstream text;
+    text << "# HELP search_engine_uptime_seconds Time since the start of the engine.\n"
+         << "# TYPE search_engine_uptime_seconds gauge\n"
+         << "search_engine_uptime_seconds " << snapshot.uptimeSeconds << "\n";
+
+    text << "# HELP search_engine_stage_seconds Duration of the stages of the engine.\n"
+         << "# TYPE search_engine_stage_seconds histogram\n";
+    for (size_t i = 0; i < stagesNum; i++) {
+        const StageMetrics &stage = snapshot.stages[i];
+        uint64_t cumulative = 0;
+        for (size_t j = 0; j < StageMetrics::bucketsNum; j++) {
+            cumulative += stage.buckets[j];
+            text << "search_engine_stage_seconds_bucket{stage=\"" << stageNames[i] << "\",le=\"";
+            if (j + 1 < StageMetrics::bucketsNum)
+                text << getBucketBound(j);
+            else
+                text << "+Inf";
+            text << "\"} " << cumulative << "\n";
+        }
+        text << "search_engine_stage_seconds_sum{stage=\"" << stageNames[i] << "\"} "
+             << toSeconds(stage.nanoseconds) << "\n"
+             << "search_engine_stage_seconds_count{stage=\"" << stageNames[i] << "\"} " << stage.calls << "\n";
+    }
+
+    for (size_t i = 0; i < countersNum; i++) {
+        text << "# TYPE search_engine_" << counterNames[i] << "_total counter\n"
+             << "search_engine_" << counterNames[i] << "_total " << snapshot.counters[i] << "\n";
+    }
+
+    text << "# HELP search_engine_thread_busy_seconds_total Time the worker threads spent working.\n"
+         << "# TYPE search_engine_thread_busy_seconds_total counter\n";
+    for (auto &thread : snapshot.threads)
+        text << "search_engine_thread_busy_seconds_total{thread=\"" << thread.thread << "\"} "
+             << thread.busySeconds << "\n";
+    text << "# HELP search_engine_thread_utilization Share of the life of the worker threads spent working.\n"
+         << "# TYPE search_engine_thread_utilization gauge\n";
+    for (auto &thread : snapshot.threads)
+        text << "search_engine_thread_utilization{thread=\"" << thread.thread << "\"} "
+             << (thread.aliveSeconds > 0 ? thread.busySeconds / thread.aliveSeconds : 0) << "\n";
+    return text.str();
+}
+
+nlohmann::json Metrics::getJson() {
+    MetricsSnapshot snapshot = collect();
+    nlohmann::json metrics;
+    metrics["enabled"] = isEnabled();
+    metrics["uptime_seconds"] = snapshot.uptimeSeconds;
+    for (size_t i = 0; i < stagesNum; i++) {
+        const StageMetrics &stage = snapshot.stages[i];
+        nlohmann::json &json = metrics["stages"][stageNames[i]];
+        json["calls"] = stage.calls;
+        json["seconds"] = toSeconds(stage.nanoseconds);
+        json["mean_seconds"] = stage.calls != 0 ? toSeconds(stage.nanoseconds) / (double) stage.calls : 0;
+        json["p50_seconds"] = getQuantile(stage, 0.5);
+        json["p99_seconds"] = getQuantile(stage, 0.99);
+    }
+    for (size_t i = 0; i < countersNum; i++)
+        metrics["counters"][counterNames[i]] = snapshot.counters[i];
+    metrics["threads"] = nlohmann::json::array();
+    for (auto &thread : snapshot.threads) {
+        metrics["threads"].push_back({{"thread", thread.thread}, {"busy_seconds", thread.busySeconds},
+                                      {"utilization", thread.aliveSeconds > 0 ?
+                                                      thread.busySeconds / thread.aliveSeconds : 0}});
+    }
+    return metrics;
+}
+
+status Metrics::writeFile(const std::string &path) {
+    const std::string jsonExtension = ".json";
+    bool isJson = path.size() >= jsonExtension.size() &&
+                  path.compare(path.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0;
+    std::string text = isJson ? getJson().dump(4) : getPrometheusText();
+    return FileExchange::writeToFile(text, path);
+}
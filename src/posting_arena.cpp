@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cassert>
+#include "posting_arena.h"
+
+const uint32_t PostingArena::npos;
+const size_t PostingArena::pageWords;
+const uint32_t PostingArena::firstChunkEntries;
+const uint32_t PostingArena::maxChunkEntries;
+const uint32_t PostingArena::headerWords;
+
+void PostingArena::add(uint32_t termId, uint32_t docId, uint32_t count) {
+    if (termId < lists.size() && lists[termId].lastDocId == docId) {
+        uint32_t *tail = getChunk(lists[termId].tail);
+        tail[headerWords + 2 * (tail[2] - 1) + 1] += count;
+        return;
+    }
+    addPair(termId, docId, count);
+}
+
+void PostingArena::addOccurrence(uint32_t termId, Occurrence occurrence) {
+    addPair(termId, occurrence.docId, occurrence.position);
+}
+
+void PostingArena::addPair(uint32_t termId, uint32_t first, uint32_t second) {
+    if (termId == lists.size()) {
+        uint32_t chunk = newChunk(firstChunkEntries);
+        lists.push_back({chunk, chunk, npos});
+    }
+    TermList &list = lists[termId];
+    uint32_t *tail = getChunk(list.tail);
+    if (tail[2] == tail[1]) {
+        uint32_t chunk = newChunk(std::min(tail[1] * 2, maxChunkEntries));
+        ///< A new page may have been added, the address of the tail is taken again
+        getChunk(list.tail)[0] = chunk;
+        list.tail = chunk;
+        tail = getChunk(chunk);
+    }
+    uint32_t *entry = tail + headerWords + 2 * tail[2]++;
+    entry[0] = first;
+    entry[1] = second;
+    list.lastDocId = first;
+}
+
+void PostingArena::appendTo(uint32_t termId, std::vector<Entry> &entries) const {
+    for (uint32_t address = lists[termId].head; address != npos;) {
+        const uint32_t *chunk = getChunk(address);
+        for (uint32_t i = 0; i < chunk[2]; i++)
+            entries.push_back({chunk[headerWords + 2 * i], chunk[headerWords + 2 * i + 1]});
+        address = chunk[0];
+    }
+}
+
+void PostingArena::appendTo(uint32_t termId, std::vector<Occurrence> &occurrences) const {
+    for (uint32_t address = lists[termId].head; address != npos;) {
+        const uint32_t *chunk = getChunk(address);
+        for (uint32_t i = 0; i < chunk[2]; i++)
+            occurrences.push_back({chunk[headerWords + 2 * i], chunk[headerWords + 2 * i + 1]});
+        address = chunk[0];
+    }
+}
+
+void PostingArena::clear() {
+    std::vector<page_t>().swap(pages);
+    lists = decltype(lists)();
+    pageUsed = pageWords;
+}
+
+uint32_t PostingArena::newChunk(uint32_t capacity) {
+    size_t words = headerWords + 2 * (size_t) capacity;
+    if (pageUsed + words > pageWords) {
+        assert (pages.size() < UINT32_MAX / pageWords);
+        pages.emplace_back(pageWords);
+        pageUsed = 0;
+    }
+    auto address = (uint32_t) ((pages.size() - 1) * pageWords + pageUsed);
+    uint32_t *chunk = pages.back().data() + pageUsed;
+    chunk[0] = npos;
+    chunk[1] = capacity;
+    chunk[2] = 0;
+    pageUsed += words;
+    return address;
+}
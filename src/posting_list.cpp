@@ -0,0 +1,367 @@
+#include <cassert>
+#include <algorithm>
+#include "posting_list.h"
+
+namespace {
+template<typename Bytes>
+void writeVarint(Bytes &bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back((uint8_t) value);
+}
+
+inline uint32_t readVarint(const uint8_t *&bytes) {
+    ///< Most gaps and counts are below 128 and take one byte
+    if (*bytes < 0x80)
+        return *bytes++;
+    uint32_t value = *bytes & 0x7f;
+    for (int shift = 7; *bytes++ & 0x80; shift += 7)
+        value |= (uint32_t) (*bytes & 0x7f) << shift;
+    return value;
+}
+}
+
+void sortEntries(std::vector<Entry> &entries) {
+    auto byDocId = [] (const Entry &a, const Entry &b) {
+        return a.docId < b.docId;
+    };
+    if (!std::is_sorted(entries.begin(), entries.end(), byDocId))
+        std::sort(entries.begin(), entries.end(), byDocId);
+    size_t merged = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (merged != 0 && entries[merged - 1].docId == entries[i].docId)
+            entries[merged - 1].count += entries[i].count;
+        else
+            entries[merged++] = entries[i];
+    }
+    entries.resize(merged);
+}
+
+void groupOccurrences(std::vector<Occurrence> &occurrences, std::vector<Entry> &entries,
+                      std::vector<uint32_t> &positions) {
+    auto byPlace = [] (const Occurrence &a, const Occurrence &b) {
+        return a.docId < b.docId || (a.docId == b.docId && a.position < b.position);
+    };
+    if (!std::is_sorted(occurrences.begin(), occurrences.end(), byPlace))
+        std::sort(occurrences.begin(), occurrences.end(), byPlace);
+    entries.clear();
+    positions.clear();
+    positions.reserve(occurrences.size());
+    for (auto &occurrence : occurrences) {
+        if (entries.empty() || entries.back().docId != occurrence.docId)
+            entries.push_back({occurrence.docId, 0});
+        entries.back().count++;
+        positions.push_back(occurrence.position);
+    }
+}
+
+std::vector<Entry> PostingList::decode() const {
+    std::vector<Entry> entries;
+    entries.reserve(docFrequency);
+    for (PostingCursor cursor(*this); !cursor.isEnd(); cursor.next())
+        entries.push_back({cursor.docId(), cursor.count()});
+    return entries;
+}
+
+PostingCursor::PostingCursor(const PostingList &inPostings) : postings(inPostings) {
+    blocksNum = (postings.docFrequency + postingBlockSize - 1) / postingBlockSize;
+    if (blocksNum != 0)
+        decodeBlock(0);
+}
+
+void PostingCursor::next() {
+    if (++position == blockEntries && block + 1 < blocksNum)
+        decodeBlock(block + 1);
+}
+
+void PostingCursor::seek(uint32_t target) {
+    if (isEnd() || docIds[position] >= target)
+        return;
+    if (postings.blocks[block].lastDocId < target) {
+        const PostingBlock *first = postings.blocks + block + 1;
+        const PostingBlock *last = postings.blocks + blocksNum;
+        const PostingBlock *found = std::lower_bound(first, last, target, [] (const PostingBlock &a, uint32_t id) {
+            return a.lastDocId < id;
+        });
+        if (found == last) {
+            position = blockEntries;
+            return;
+        }
+        decodeBlock(found - postings.blocks);
+    }
+    while (docIds[position] < target)
+        position++;
+}
+
+void PostingCursor::decodeBlock(size_t newBlock) {
+    block = newBlock;
+    position = 0;
+    blockEntries = std::min(postingBlockSize, postings.docFrequency - block * postingBlockSize);
+
+    countsDecoded = false;
+    positionsBytes = nullptr;
+
+    const uint8_t *docBytes = postings.docBytes + postings.blocks[block].docOffset;
+    uint32_t docId = block == 0 ? 0 : postings.blocks[block - 1].lastDocId;
+    for (size_t i = 0; i < blockEntries; i++) {
+        docId += readVarint(docBytes);
+        docIds[i] = docId;
+    }
+}
+
+void PostingCursor::decodeCounts() const {
+    const uint8_t *countBytes = postings.countBytes + postings.blocks[block].countOffset;
+    for (size_t i = 0; i < blockEntries; i++)
+        counts[i] = readVarint(countBytes);
+    countsDecoded = true;
+}
+
+void PostingCursor::getPositions(std::vector<uint32_t> &positions) {
+    assert (postings.hasPositions());
+    if (!countsDecoded)
+        decodeCounts();
+    ///< The cursor only moves forward in a block, so the positions are decoded from where the last request stopped
+    if (positionsBytes == nullptr || positionsEntry > position) {
+        positionsBytes = postings.positionBytes + postings.positionOffsets[block];
+        positionsEntry = 0;
+    }
+    ///< The positions of the skipped entries are not decoded, only the last bytes of their varints are counted
+    size_t skipped = 0;
+    for (; positionsEntry < position; positionsEntry++)
+        skipped += counts[positionsEntry];
+    for (; skipped != 0; positionsBytes++)
+        skipped -= *positionsBytes < 0x80;
+    positions.resize(counts[position]);
+    uint32_t wordPosition = 0;
+    for (auto &wordPositionRef : positions)
+        wordPositionRef = wordPosition += readVarint(positionsBytes);
+    positionsEntry++;
+}
+
+PhraseCursor::PhraseCursor(const std::vector<PostingList> &words, uint32_t inSlop)
+                          : slop(inSlop), positions(words.size()) {
+    assert (!words.empty());
+    cursors.reserve(words.size());
+    for (auto &word : words)
+        cursors.emplace_back(word);
+    findMatch();
+}
+
+void PhraseCursor::next() {
+    cursors[0].next();
+    findMatch();
+}
+
+void PhraseCursor::seek(uint32_t target) {
+    cursors[0].seek(target);
+    findMatch();
+}
+
+void PhraseCursor::findMatch() {
+    if (cursors.size() == 1)
+        return;
+    while (!cursors[0].isEnd()) {
+        ///< Every cursor is sought to the document of the first one, a cursor that passes it moves the first one on
+        uint32_t target = cursors[0].docId();
+        bool isAligned = true;
+        for (size_t i = 1; i < cursors.size() && isAligned; i++) {
+            cursors[i].seek(target);
+            if (cursors[i].isEnd()) {
+                cursors[0].seek(UINT32_MAX);
+                return;
+            }
+            if (cursors[i].docId() != target) {
+                cursors[0].seek(cursors[i].docId());
+                isAligned = false;
+            }
+        }
+        if (!isAligned)
+            continue;
+        matches = countMatches();
+        if (matches != 0)
+            return;
+        cursors[0].next();
+    }
+}
+
+uint32_t PhraseCursor::countMatches() {
+    for (size_t i = 0; i < cursors.size(); i++)
+        cursors[i].getPositions(positions[i]);
+
+    ///< From the last word back, a position is kept if a kept position of the next word follows it closely enough,
+    ///< so the positions of the first word left are the ones that begin a match. The nearest following position
+    ///< is the only one to check.
+    for (size_t i = cursors.size() - 1; i-- > 0;) {
+        auto &wordPositions = positions[i];
+        const auto &following = positions[i + 1];
+        size_t next = 0, kept = 0;
+        for (uint32_t position : wordPositions) {
+            while (next < following.size() && following[next] <= position)
+                next++;
+            if (next < following.size() && following[next] - position - 1 <= slop)
+                wordPositions[kept++] = position;
+        }
+        if (kept == 0)
+            return 0;
+        wordPositions.resize(kept);
+    }
+    return (uint32_t) positions[0].size();
+}
+
+void PostingStore::append(const std::vector<Entry> &entries, const std::vector<uint32_t> *positions) {
+    auto &blockHeaders = blocks.modify();
+    auto &encodedDocs = docBytes.modify();
+    auto &encodedCounts = countBytes.modify();
+    assert (positions == nullptr || (movedDocBytes == 0 && (blockHeaders.empty() || hasPositions())));
+    auto *encodedPositions = positions != nullptr ? &positionBytes.modify() : nullptr;
+    size_t nextPosition = 0;
+
+    TermInfo term{};
+    term.firstBlock = (uint32_t) blockHeaders.size();
+    term.docFrequency = (uint32_t) entries.size();
+
+    uint32_t previous = 0;
+    for (size_t first = 0; first < entries.size(); first += postingBlockSize) {
+        PostingBlock header{};
+        header.docOffset = movedDocBytes + encodedDocs.size();
+        header.countOffset = movedCountBytes + encodedCounts.size();
+        if (positions != nullptr)
+            positionOffsets.modify().push_back(encodedPositions->size());
+        size_t last = std::min(entries.size(), first + postingBlockSize);
+        for (size_t i = first; i < last; i++) {
+            assert (entries[i].docId <= UINT32_MAX && entries[i].count <= UINT32_MAX);
+            auto docId = (uint32_t) entries[i].docId;
+            auto count = (uint32_t) entries[i].count;
+            writeVarint(encodedDocs, docId - previous);
+            writeVarint(encodedCounts, count);
+            if (positions != nullptr) {
+                assert (nextPosition + count <= positions->size());
+                uint32_t position = 0;
+                for (size_t end = nextPosition + count; nextPosition < end; nextPosition++) {
+                    writeVarint(*encodedPositions, (*positions)[nextPosition] - position);
+                    position = (*positions)[nextPosition];
+                }
+            }
+            previous = docId;
+            header.maxCount = std::max(header.maxCount, count);
+            term.totalCount += count;
+        }
+        header.lastDocId = previous;
+        term.maxCount = std::max(term.maxCount, header.maxCount);
+        blockHeaders.push_back(header);
+    }
+    terms.modify().push_back(term);
+}
+
+PostingList PostingStore::getPostings(uint32_t termId) const {
+    const TermInfo &term = terms[termId];
+    PostingList postings;
+    postings.blocks = blocks.data() + term.firstBlock;
+    postings.docBytes = docBytes.data();
+    postings.countBytes = countBytes.data();
+    if (hasPositions()) {
+        postings.positionOffsets = positionOffsets.data() + term.firstBlock;
+        postings.positionBytes = positionBytes.data();
+    }
+    postings.docFrequency = term.docFrequency;
+    postings.totalCount = term.totalCount;
+    postings.maxCount = term.maxCount;
+    return postings;
+}
+
+void PostingStore::clear() {
+    terms.clear();
+    blocks.clear();
+    docBytes.clear();
+    countBytes.clear();
+    positionOffsets.clear();
+    positionBytes.clear();
+    movedDocBytes = 0;
+    movedCountBytes = 0;
+}
+
+void PostingStore::moveBytesTo(std::ostream &docFile, std::ostream &countFile) {
+    assert (!hasPositions());
+    docFile.write((const char *) docBytes.data(), (std::streamsize) docBytes.size());
+    countFile.write((const char *) countBytes.data(), (std::streamsize) countBytes.size());
+    movedDocBytes += docBytes.size();
+    movedCountBytes += countBytes.size();
+    ///< The capacity is kept, the next terms are encoded into the same memory
+    docBytes.modify().clear();
+    countBytes.modify().clear();
+}
+
+void PostingStore::shrinkToFit() {
+    terms.shrinkToFit();
+    blocks.shrinkToFit();
+    docBytes.shrinkToFit();
+    countBytes.shrinkToFit();
+    positionOffsets.shrinkToFit();
+    positionBytes.shrinkToFit();
+}
+
+void PostingStore::writeTo(IndexFileWriter &writer) const {
+    writer.addSection(IndexSection::PostingTerms, terms);
+    writer.addSection(IndexSection::PostingBlocks, blocks);
+    writer.addSection(IndexSection::PostingDocBytes, docBytes);
+    writer.addSection(IndexSection::PostingCountBytes, countBytes);
+    if (hasPositions()) {
+        writer.addSection(IndexSection::PostingPositionOffsets, positionOffsets);
+        writer.addSection(IndexSection::PostingPositionBytes, positionBytes);
+    }
+}
+
+void PostingStore::writeTo(IndexFileWriter &writer, const std::string &docBytesPath,
+                           const std::string &countBytesPath) const {
+    writer.addSection(IndexSection::PostingTerms, terms);
+    writer.addSection(IndexSection::PostingBlocks, blocks);
+    writer.addSection(IndexSection::PostingDocBytes, docBytesPath);
+    writer.addSection(IndexSection::PostingCountBytes, countBytesPath);
+}
+
+bool PostingStore::readFrom(const IndexFileReader &reader, size_t docsAmount) {
+    if (!reader.attachSection(IndexSection::PostingTerms, terms) ||
+            !reader.attachSection(IndexSection::PostingBlocks, blocks) ||
+            !reader.attachSection(IndexSection::PostingDocBytes, docBytes) ||
+            !reader.attachSection(IndexSection::PostingCountBytes, countBytes))
+        return false;
+    ///< The positions are optional, but a file that has them has them for every block
+    const char *data;
+    size_t size;
+    if (reader.findSection(IndexSection::PostingPositionOffsets, data, size) &&
+            (!reader.attachSection(IndexSection::PostingPositionOffsets, positionOffsets) ||
+             !reader.attachSection(IndexSection::PostingPositionBytes, positionBytes) ||
+             positionOffsets.size() != blocks.size()))
+        return false;
+
+    ///< The cursors use the terms and the blocks without checks, so they are checked here. The encoded bytes
+    ///< are left to the checksum of the file, reading them would defeat lazy loading of the pages.
+    size_t nextBlock = 0;
+    for (size_t termId = 0; termId < terms.size(); termId++) {
+        const TermInfo &term = terms[termId];
+        if (term.firstBlock != nextBlock)
+            return false;
+        nextBlock += (term.docFrequency + postingBlockSize - 1) / postingBlockSize;
+        if (nextBlock > blocks.size())
+            return false;
+    }
+    if (nextBlock != blocks.size())
+        return false;
+    ///< Every block holds at least one byte of every stream, so its offsets are above the ones of the block before
+    ///< and below the end of the stream, and a block ends where the next one begins
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const PostingBlock &block = blocks[i];
+        bool isAfterPrevious = i == 0 || (block.docOffset > blocks[i - 1].docOffset &&
+                                          block.countOffset > blocks[i - 1].countOffset &&
+                                          (!hasPositions() || positionOffsets[i] > positionOffsets[i - 1]));
+        if (!isAfterPrevious || block.lastDocId >= docsAmount)
+            return false;
+    }
+    if (blocks.empty())
+        return true;
+    const PostingBlock &last = blocks[blocks.size() - 1];
+    return last.docOffset < docBytes.size() && last.countOffset < countBytes.size() &&
+           (!hasPositions() || positionOffsets[positionOffsets.size() - 1] < positionBytes.size());
+}
@@ -0,0 +1,252 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include "query_daemon.h"
+#include "bounded_queue.h"
+#include "converter_json.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+#ifndef _WIN32
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+QueryDaemon::QueryDaemon(SearchServer &inServer, size_t inMaxPipelined)
+                        : server(&inServer), maxPipelined(inMaxPipelined > 0 ? inMaxPipelined : 1) {
+    search = [this](const std::vector<std::string> &requests) {
+        return server->search(requests);
+    };
+}
+
+QueryDaemon::QueryDaemon(search_function_t inSearch, size_t inMaxPipelined)
+                        : server(nullptr), search(std::move(inSearch)),
+                          maxPipelined(inMaxPipelined > 0 ? inMaxPipelined : 1) {}
+
+/*!
+ * The function reads the requests of a line.
+ * @param [in] texts the array of the requests
+ * @param [out] requests the requests
+ * @return true if every request is a string
+ */
+static bool getRequests(const nlohmann::json &texts, std::vector<std::string> &requests) {
+    for (auto &text : texts) {
+        if (!text.is_string())
+            return false;
+        requests.push_back(text);
+    }
+    return true;
+}
+
+std::string QueryDaemon::processLine(const std::string &line) {
+    nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+    if (request.is_discarded() || !request.is_object())
+        return nlohmann::json({{"error", "the line is not a JSON object"}}).dump();
+
+    if (request["command"] == "stats" && server != nullptr) {
+        CacheStats stats = server->getCacheStats();
+        nlohmann::json cache = {{"capacity", stats.capacity}, {"size", stats.size}, {"hits", stats.hits},
+                                {"misses", stats.misses}, {"evictions", stats.evictions},
+                                {"hit_rate", stats.getHitRate()}};
+        return nlohmann::json({{"cache", cache}}).dump();
+    }
+    if (request["command"] == "metrics")
+        return nlohmann::json({{"metrics", Metrics::getJson()}}).dump();
+    if (request["command"] == "documents" && server != nullptr)
+        return nlohmann::json({{"documents", server->getIndex()->getDocsAmount()}}).dump();
+
+    if (!request["command"].is_null())
+        return nlohmann::json({{"error", "the command is not supported"}}).dump();
+
+    std::vector<std::string> requests;
+    if (request["top"].is_array() && server != nullptr) {
+        if (!getRequests(request["top"], requests))
+            return nlohmann::json({{"error", "a request is not a string"}}).dump();
+        nlohmann::json tops = nlohmann::json::array();
+        for (auto &top : server->searchAbsolute(requests)) {
+            nlohmann::json documents = nlohmann::json::array();
+            for (auto &document : top)
+                documents.push_back({document.docId, document.absolute});
+            tops.push_back(std::move(documents));
+        }
+        return nlohmann::json({{"top", std::move(tops)}}).dump();
+    }
+
+    if (!request["requests"].is_array())
+        return nlohmann::json({{"error", "the object has no \"requests\" array"}}).dump();
+    if (!getRequests(request["requests"], requests))
+        return nlohmann::json({{"error", "a request is not a string"}}).dump();
+    nlohmann::json answers = ConverterJSON::getAnswersJson(SearchServer::convert(search(requests)));
+    if (answers.is_null())
+        answers["answers"] = nlohmann::json::array();
+    return answers.dump();
+}
+
+void QueryDaemon::serveConnection(const line_reader_t &readLine, const line_writer_t &writeLine) {
+    ///< The answers are written in the order of the lines while the later lines are still being searched
+    BoundedQueue<std::shared_future<std::string>> pending(maxPipelined);
+    std::thread writer([&pending, &writeLine]() {
+        std::shared_future<std::string> answer;
+        bool connected = true;
+        while (pending.pop(answer)) {
+            std::string line = answer.get();
+            if (connected)
+                connected = writeLine(line);
+        }
+    });
+
+    std::string line;
+    while (readLine(line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        auto task = std::make_shared<std::packaged_task<std::string()>>([this, line]() {
+            try {
+                return processLine(line);
+            } catch (const std::exception &e) {
+                return nlohmann::json({{"error", e.what()}}).dump();
+            }
+        });
+        pending.push(task->get_future().share());
+        ThreadPool::shared().submit([task]() { (*task)(); });
+    }
+    pending.close();
+    writer.join();
+}
+
+void QueryDaemon::serveStdio() {
+    std::mutex outputAccess;
+    serveConnection([](std::string &line) {
+        return (bool) std::getline(std::cin, line);
+    }, [&outputAccess](const std::string &line) {
+        std::lock_guard<std::mutex> lock(outputAccess);
+        std::cout << line << std::endl;
+        return (bool) std::cout;
+    });
+}
+
+#ifdef _WIN32
+
+status QueryDaemon::serveSocket(const std::string &path) {
+    std::cerr << "Unix domain sockets are not supported on this system, use the standard input" << std::endl;
+    return status::ERROR;
+}
+
+void QueryDaemon::stop() {
+    stopping = true;
+}
+
+void QueryDaemon::serveClient(int clientSocket) {}
+
+#else
+
+status QueryDaemon::serveSocket(const std::string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The socket path is too long: " << path << std::endl;
+        return status::ERROR;
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+
+    int listening = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listening < 0 || bind(listening, (sockaddr *) &address, sizeof(address)) != 0 ||
+            listen(listening, SOMAXCONN) != 0) {
+        std::cerr << "Can't listen on the socket " << path << ": " << std::strerror(errno) << std::endl;
+        if (listening >= 0)
+            close(listening);
+        return status::ERROR;
+    }
+    listenSocket = listening;
+    if (stopping)
+        shutdown(listening, SHUT_RDWR);
+
+    while (!stopping) {
+        int client = accept(listening, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(clientsAccess);
+        if (stopping) {
+            close(client);
+            break;
+        }
+        clientSockets.insert(client);
+        std::thread(&QueryDaemon::serveClient, this, client).detach();
+    }
+
+    ///< The clients are disconnected, their threads finish the lines that were read and quit
+    {
+        std::unique_lock<std::mutex> lock(clientsAccess);
+        for (int client : clientSockets)
+            shutdown(client, SHUT_RDWR);
+        clientsDone.wait(lock, [this]() { return clientSockets.empty(); });
+    }
+    listenSocket = -1;
+    close(listening);
+    unlink(path.c_str());
+    return status::OK;
+}
+
+void QueryDaemon::stop() {
+    std::lock_guard<std::mutex> lock(clientsAccess);
+    stopping = true;
+    int listening = listenSocket;
+    if (listening >= 0)
+        shutdown(listening, SHUT_RDWR);
+}
+
+void QueryDaemon::serveClient(int clientSocket) {
+    std::string buffer;
+    size_t begin = 0;
+    serveConnection([clientSocket, &buffer, &begin](std::string &line) {
+        for (;;) {
+            size_t end = buffer.find('\n', begin);
+            if (end != std::string::npos) {
+                line.assign(buffer, begin, end - begin);
+                begin = end + 1;
+                return true;
+            }
+            buffer.erase(0, begin);
+            begin = 0;
+            char block[4096];
+            ssize_t received = recv(clientSocket, block, sizeof(block), 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0) {
+                ///< The last line may have no line end
+                line = buffer;
+                buffer.clear();
+                return !line.empty();
+            }
+            buffer.append(block, (size_t) received);
+        }
+    }, [clientSocket](const std::string &line) {
+        std::string data = line + '\n';
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t written = send(clientSocket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            sent += (size_t) written;
+        }
+        return true;
+    });
+
+    std::lock_guard<std::mutex> lock(clientsAccess);
+    close(clientSocket);
+    clientSockets.erase(clientSocket);
+    clientsDone.notify_all();
+}
+
+#endif
@@ -3,97 +3,369 @@
 //
 
 #include <algorithm>
+#include <cctype>
 #include <utility>
+#include <queue>
+#include <limits>
+#include <mutex>
 #include "converter_json.h"
 #include "file_exchange.h"
+#include "metrics.h"
 #include "search_server.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
 
-typedef std::vector<std::pair<std::string, size_t>> pairs_t;
+typedef std::pair<size_t, size_t> candidate_t; ///< absolute relevance and docId of a top-k candidate
 
-SearchServer::SearchServer(InvertedIndex &inIndex) : index(inIndex) {}
+/*!
+ * A word or a phrase of a query found in a segment
+ */
+struct QueryTerm {
+    std::vector<PostingList> words; ///< postings of the words, one for a word
+    uint32_t slop;
+    size_t upperBound;              ///< the highest count of the term in one document
+};
 
-std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string> &queriesInput) {
-    ///< This condition is necessary for the correct operation of the application during testing.
-    if (JSON::config == 0)
-        FileExchange::readFromFile(JSON::config, "..\\config.json");
+/*!
+ * Position in the postings of one query term during document-at-a-time scoring
+ */
+template<typename Cursor>
+struct TermCursor {
+    Cursor postings;
+    size_t upperBound;
+};
 
-    std::vector<std::vector<RelativeIndex>> result;
+static PostingCursor makeCursor(const QueryTerm &term, const PostingCursor *) {
+    return PostingCursor(term.words[0]);
+}
 
-    for (auto const &request: queriesInput) {
-        std::vector<std::string> sortedWords = sortUniqueWords(getUniqueWords(request));
+static PhraseCursor makeCursor(const QueryTerm &term, const PhraseCursor *) {
+    return PhraseCursor(term.words, term.slop);
+}
 
-        std::vector<size_t> docIds;
-        for (size_t i = 0; i < index.getDocsAmount(); i++)
-            docIds.push_back(i);
+/*!
+ * Order of the top-k heap: a candidate is better if its relevance is higher or, with equal relevance,
+ * its docId is lower. The worst candidate is kept on top of the heap.
+ */
+struct BetterCandidate {
+    bool operator()(const candidate_t &a, const candidate_t &b) const {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+};
 
-        std::vector<RelativeIndex> relativeIndexes(0);
-        std::vector<size_t> absolutes;
-        for (auto &docId: docIds)
-            absolutes.push_back(calcAbsoluteForDoc(docId, sortedWords));
+typedef std::priority_queue<candidate_t, std::vector<candidate_t>, BetterCandidate> top_t;
 
-        calcRelative(docIds, absolutes, relativeIndexes);
+/*!
+ * The function returns the relevance a document needs to enter the top
+ * @param [in] top the best documents found so far
+ * @param [in] limit the size of the top
+ * @param [in] docId id of the document
+ * @return the lowest relevance of the document that puts it into the top
+ */
+static size_t getRequiredRelevance(const top_t &top, size_t limit, size_t docId) {
+    if (top.size() < limit)
+        return 0;
+    ///< With equal relevance the lower docId wins, so a document may replace an equal one with a higher docId
+    return top.top().first + (top.top().second < docId ? 1 : 0);
+}
 
-        result.push_back(relativeIndexes);
+/*!
+ * The function adds the best documents of one segment of the index to the top
+ * @param [in] index the index
+ * @param [in] segment index of the segment
+ * @param [in] terms the words and the phrases of the query found in the segment
+ * @param [in] limit the size of the top
+ * @param [in, out] top the best documents found so far
+ */
+template<typename Cursor>
+static void addSegmentTop(const InvertedIndex &index, size_t segment, std::vector<QueryTerm> &terms,
+                          size_t limit, top_t &top) {
+    bool hasDeletedDocs = index.hasDeletedDocs(segment);
+    std::sort(terms.begin(), terms.end(), [] (const QueryTerm &a, const QueryTerm &b) {
+        return a.upperBound < b.upperBound;
+    });
+    ///< Cursors hold their decoded block, so they are created in place once the order is known
+    std::vector<TermCursor<Cursor>> cursors(terms.size());
+    for (size_t i = 0; i < terms.size(); i++)
+        cursors[i] = {makeCursor(terms[i], (const Cursor *) nullptr), terms[i].upperBound};
+
+    ///< boundSums[i] is the highest relevance a document can get from the words 0..i
+    std::vector<size_t> boundSums(cursors.size());
+    size_t boundSum = 0;
+    for (size_t i = 0; i < cursors.size(); i++)
+        boundSums[i] = boundSum += cursors[i].upperBound;
+
+    size_t essential = 0; ///< documents are enumerated from the words [essential, cursors.size())
+    size_t scanned = 0, scored = 0;
+    while (essential < cursors.size()) {
+        size_t docId = std::numeric_limits<size_t>::max();
+        for (size_t i = essential; i < cursors.size(); i++) {
+            if (!cursors[i].postings.isEnd() && cursors[i].postings.docId() < docId)
+                docId = cursors[i].postings.docId();
+        }
+        if (docId == std::numeric_limits<size_t>::max())
+            break;
+
+        ///< A removed or replaced document is skipped, its live version is scored by another segment
+        bool isLive = !hasDeletedDocs || index.isLive(segment, (uint32_t) docId);
+        size_t absolute = 0;
+        for (size_t i = essential; i < cursors.size(); i++) {
+            auto &postings = cursors[i].postings;
+            if (!postings.isEnd() && postings.docId() == docId) {
+                if (isLive)
+                    absolute += postings.count();
+                postings.next();
+                scanned++;
+            }
+        }
+        if (!isLive)
+            continue;
+        scored++;
+
+        ///< The rest of the words is looked up only while the document can still enter the top
+        size_t required = getRequiredRelevance(top, limit, docId);
+        for (size_t i = essential; i-- > 0 && absolute + boundSums[i] >= required;) {
+            auto &postings = cursors[i].postings;
+            postings.seek((uint32_t) docId);
+            scanned++;
+            if (!postings.isEnd() && postings.docId() == docId)
+                absolute += postings.count();
+        }
+
+        if (absolute < required)
+            continue;
+        if (top.size() == limit)
+            top.pop();
+        top.emplace(absolute, docId);
+
+        ///< The next documents of the segment have higher docIds, the words that can't lift them into the top are dropped
+        if (top.size() == limit) {
+            required = getRequiredRelevance(top, limit, docId + 1);
+            while (essential < cursors.size() && boundSums[essential] < required)
+                essential++;
+        }
     }
-    return result;
+    METRICS_ADD(MetricCounter::PostingsScanned, scanned);
+    METRICS_ADD(MetricCounter::DocumentsScored, scored);
 }
 
-std::unordered_set<std::string> SearchServer::getUniqueWords(const std::string &request) {
-        std::stringstream wordsStream(request);
-        std::unordered_set<std::string> uniqueWords;
-        while (true) {
-            std::string word;
-            wordsStream >> word;
-            uniqueWords.insert(word);
-            if (wordsStream.eof())
+/*!
+ * The function finds the words and the phrases of a query in one segment of the index
+ * @param [in] indexSegment the segment
+ * @param [in] words the unique words of the query
+ * @param [in] phrases the unique phrases of the query
+ * @return the terms found in the segment, a phrase is found if all its words are
+ */
+template<typename Phrase>
+static std::vector<QueryTerm> getSegmentTerms(const IndexSegment &indexSegment, const std::vector<std::string> &words,
+                                              const std::vector<Phrase> &phrases) {
+    std::vector<QueryTerm> terms;
+    for (auto &word : words) {
+        PostingList postings = indexSegment.getPostings(word);
+        if (!postings.empty())
+            terms.push_back({{postings}, 0, postings.maxCount});
+    }
+    for (auto &phrase : phrases) {
+        QueryTerm term{{}, phrase.slop, 0};
+        for (auto &word : phrase.words) {
+            PostingList postings = indexSegment.getPostings(word);
+            if (postings.empty())
                 break;
+            term.words.push_back(postings);
         }
-        return uniqueWords;
-}
-
-std::vector<std::string> SearchServer::sortUniqueWords(const std::unordered_set<std::string> &uniqueWords) {
-    pairs_t sorted;
-    for (auto const &uniqueWord: uniqueWords) {
-        auto freqDictionary = index.getFreqDictionary();
-        auto it = freqDictionary.find(uniqueWord);
-        size_t sum = 0;
-        if (it != freqDictionary.end()) {
-            for (auto const &entry: it->second) {
-                sum += entry.count;
-            }
-        }
-        sorted.emplace_back(uniqueWord, sum);
+        if (term.words.size() != phrase.words.size())
+            continue;
+        ///< An exact match takes its own position of every word. With a slop the matches may share
+        ///< the positions of the next words, but never the position of the first word.
+        term.upperBound = term.words[0].maxCount;
+        for (size_t i = 1; i < term.words.size() && phrase.slop == 0; i++)
+            term.upperBound = std::min(term.upperBound, term.words[i].maxCount);
+        terms.push_back(std::move(term));
     }
+    return terms;
+}
 
-    std::sort(sorted.begin(), sorted.end(),
-                    [] (const std::pair<std::string, size_t> &a , const std::pair<std::string, size_t> &b) {
-        return a.second < b.second;
-    });
+SearchServer::SearchServer(std::shared_ptr<const InvertedIndex> inIndex) {
+    setIndex(std::move(inIndex));
+}
+
+SearchServer::SearchServer(const InvertedIndex &inIndex) {
+    setIndex(std::make_shared<const InvertedIndex>(inIndex));
+}
+
+void SearchServer::setIndex(std::shared_ptr<const InvertedIndex> inIndex) {
+    std::shared_ptr<const Snapshot> published(new Snapshot{std::move(inIndex), nextVersion++});
+    std::atomic_store(&snapshot, std::move(published));
+    ///< The results of the old snapshots can't be used anymore, a batch still running on one may add a few more
+    cache.clear();
+}
+
+std::shared_ptr<const InvertedIndex> SearchServer::getIndex() const {
+    return getSnapshot()->index;
+}
+
+std::shared_ptr<const SearchServer::Snapshot> SearchServer::getSnapshot() const {
+    return std::atomic_load(&snapshot);
+}
+
+CacheStats SearchServer::getCacheStats() {
+    return cache.getStats();
+}
+
+template<typename Process>
+void SearchServer::searchBatch(const std::vector<std::string> &queriesInput, const Process &process) {
+    METRICS_TIME(MetricStage::SearchBatch);
+    size_t limit, threadsNum, cacheCapacity;
+    {
+        ///< Reading a missing field adds it to the configuration, so the batches running at once read it in turn
+        static std::mutex configAccess;
+        std::lock_guard<std::mutex> lock(configAccess);
+        ///< This condition is necessary for the correct operation of the application during testing.
+        if (JSON::config == 0)
+            FileExchange::readFromFile(JSON::config, "..\\config.json");
 
-    std::vector<std::string> result;
-    for (auto &word : sorted) {
-        result.push_back(word.first);
+        ///< The configuration is read before the threads start, they only read the index
+        limit = ConverterJSON::getResponsesLimit();
+        threadsNum = ConverterJSON::getSearchThreadsNumber();
+        cacheCapacity = ConverterJSON::getCacheCapacity();
     }
+    cache.setCapacity(cacheCapacity);
+
+    ///< The whole batch is answered from one snapshot, even if a new one is published meanwhile
+    std::shared_ptr<const Snapshot> current = getSnapshot();
+
+    ThreadPool::shared().parallelFor(queriesInput.size(), [this, &current, &queriesInput, &process, limit](size_t i) {
+        process(i, searchOne(*current, queriesInput[i], limit), limit);
+    }, threadsNum);
+}
 
+std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string> &queriesInput) {
+    std::vector<std::vector<RelativeIndex>> result(queriesInput.size());
+    searchBatch(queriesInput, [&result](size_t i, const std::vector<AbsoluteIndex> &top, size_t limit) {
+        result[i] = getRelative(top, limit);
+    });
     return result;
 }
 
-size_t SearchServer::calcAbsoluteForDoc(size_t &id, std::vector<std::string> &words) {
-    size_t sum = 0;
-    for (auto &word : words) {
-        auto freqDictionary = index.getFreqDictionary();
-        auto record = freqDictionary.find(word);
-        if (record != freqDictionary.end()) {
-            for (auto &entry : record->second) {
-                if (entry.docId == id)
-                    sum += entry.count;
-            }
+std::vector<std::vector<AbsoluteIndex>> SearchServer::searchAbsolute(const std::vector<std::string> &queriesInput) {
+    std::vector<std::vector<AbsoluteIndex>> result(queriesInput.size());
+    searchBatch(queriesInput, [&result](size_t i, std::vector<AbsoluteIndex> top, size_t /*limit*/) {
+        result[i] = std::move(top);
+    });
+    return result;
+}
+
+std::vector<AbsoluteIndex> SearchServer::searchOne(const Snapshot &current, const std::string &request,
+                                                   size_t limit) {
+    METRICS_TIME(MetricStage::Query);
+    bool lowercase = current.index->isLowercase();
+    std::vector<Phrase> phrases;
+    std::vector<std::string> words;
+    if (current.index->hasPositions() && request.find('"') != std::string::npos) {
+        std::string rest = request;
+        phrases = takePhrases(rest, lowercase);
+        words = getUniqueWords(rest, lowercase);
+    } else {
+        words = getUniqueWords(request, lowercase);
+    }
+    ///< Queries differing only in the order or the repetition of the words share the key
+    std::string key = std::to_string(limit) + ':';
+    for (auto &word : words)
+        (key += word) += ' ';
+    for (auto &phrase : phrases) {
+        key += '"';
+        for (auto &word : phrase.words)
+            (key += word) += ' ';
+        (key += "\"~") += std::to_string(phrase.slop) + ' ';
+    }
+    std::vector<AbsoluteIndex> cached;
+    if (cache.get(key, cached, current.version))
+        return cached;
+
+    std::vector<size_t> docIds;
+    std::vector<size_t> absolutes;
+    calcTopAbsolutes(*current.index, words, phrases, limit, docIds, absolutes);
+
+    ///< The top is popped from the worst document, so it is reversed to put the best first
+    std::vector<AbsoluteIndex> top(docIds.size());
+    for (size_t i = 0; i < docIds.size(); i++)
+        top[docIds.size() - 1 - i] = {docIds[i], absolutes[i]};
+    cache.put(key, top, current.version);
+    return top;
+}
+
+std::vector<std::string> SearchServer::getUniqueWords(const std::string &request, bool lowercase) {
+    std::vector<std::string> uniqueWords;
+    Tokenizer tokenizer(request, lowercase);
+    TextView word;
+    while (tokenizer.next(word))
+        uniqueWords.emplace_back(word.data, word.size);
+
+    std::sort(uniqueWords.begin(), uniqueWords.end());
+    uniqueWords.erase(std::unique(uniqueWords.begin(), uniqueWords.end()), uniqueWords.end());
+    return uniqueWords;
+}
+
+std::vector<SearchServer::Phrase> SearchServer::takePhrases(std::string &request, bool lowercase) {
+    std::vector<Phrase> phrases;
+    size_t begin;
+    while ((begin = request.find('"')) != std::string::npos) {
+        size_t end = request.find('"', begin + 1);
+        if (end == std::string::npos) {
+            request[begin] = ' ';
+            break;
+        }
+        Phrase phrase{{}, 0};
+        Tokenizer tokenizer(TextView(request.data() + begin + 1, end - begin - 1), lowercase);
+        TextView word;
+        while (tokenizer.next(word))
+            phrase.words.emplace_back(word.data, word.size);
+
+        ///< The slop is read up to the largest value that makes sense, the number of words of a document
+        size_t last = end + 1;
+        if (last + 1 < request.size() && request[last] == '~' && std::isdigit((unsigned char) request[last + 1])) {
+            uint64_t slop = 0;
+            for (last++; last < request.size() && std::isdigit((unsigned char) request[last]); last++)
+                slop = std::min<uint64_t>(slop * 10 + (request[last] - '0'), UINT32_MAX);
+            phrase.slop = (uint32_t) slop;
+        }
+        ///< The words of the phrase are copied before its text is replaced
+        if (phrase.words.size() > 1) {
+            phrases.push_back(std::move(phrase));
+            request.replace(begin, last - begin, last - begin, ' ');
+        } else {
+            request.replace(end, last - end, last - end, ' ');
+            request[begin] = ' ';
         }
     }
-    return sum;
+    std::sort(phrases.begin(), phrases.end());
+    phrases.erase(std::unique(phrases.begin(), phrases.end()), phrases.end());
+    return phrases;
 }
 
-void SearchServer::calcRelative(std::vector<size_t> &Ids, std::vector<size_t> &absolutes, std::vector<RelativeIndex> &indexes) {
+void SearchServer::calcTopAbsolutes(const InvertedIndex &snapshot, const std::vector<std::string> &words,
+                                    const std::vector<Phrase> &phrases, size_t limit,
+                                    std::vector<size_t> &Ids, std::vector<size_t> &absolutes) {
+    top_t top;
+    for (size_t segment = 0; segment < snapshot.getSegmentsNum(); segment++) {
+        std::vector<QueryTerm> terms = getSegmentTerms(snapshot.getSegment(segment), words, phrases);
+        ///< The queries without phrases keep the plain cursors, which read no positions
+        if (phrases.empty())
+            addSegmentTop<PostingCursor>(snapshot, segment, terms, limit, top);
+        else
+            addSegmentTop<PhraseCursor>(snapshot, segment, terms, limit, top);
+    }
+
+    Ids.reserve(top.size());
+    absolutes.reserve(top.size());
+    for (; !top.empty(); top.pop()) {
+        Ids.push_back(top.top().second);
+        absolutes.push_back(top.top().first);
+    }
+}
+
+void SearchServer::calcRelative(std::vector<size_t> &Ids, std::vector<size_t> &absolutes, size_t limit,
+                                std::vector<RelativeIndex> &indexes) {
     size_t max = 0;
     for (size_t &absolute : absolutes) {
         if (max < absolute)
@@ -109,15 +381,25 @@ void SearchServer::calcRelative(std::vector<size_t> &Ids, std::vector<size_t> &a
         return a.rank > b.rank || a.rank == b.rank && a.docId < b.docId;
     });
 
-
-    auto limit = ConverterJSON::getResponsesLimit();
     if (indexes.size() > limit)
         indexes.resize(limit);
 
-    while (indexes.back().rank == 0)
+    while (!indexes.empty() && indexes.back().rank == 0)
         indexes.pop_back();
 }
 
+std::vector<RelativeIndex> SearchServer::getRelative(const std::vector<AbsoluteIndex> &top, size_t limit) {
+    std::vector<size_t> Ids(top.size());
+    std::vector<size_t> absolutes(top.size());
+    for (size_t i = 0; i < top.size(); i++) {
+        Ids[i] = top[i].docId;
+        absolutes[i] = top[i].absolute;
+    }
+    std::vector<RelativeIndex> indexes;
+    calcRelative(Ids, absolutes, limit, indexes);
+    return indexes;
+}
+
 std::vector<std::vector<std::pair<size_t, double>>> SearchServer::convert(
                                                 const std::vector<std::vector<RelativeIndex>> &searchResult) {
 
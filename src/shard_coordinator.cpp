@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "shard_coordinator.h"
+#include "converter_json.h"
+#include "metrics.h"
+
+#ifndef _WIN32
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+ShardCoordinator::ShardCoordinator(std::string inExecutable, size_t inShardsNum)
+                                  : executable(std::move(inExecutable)), shardsNum(inShardsNum > 0 ? inShardsNum : 1) {}
+
+std::vector<size_t> ShardCoordinator::splitFiles(const std::vector<DocumentSource> &sources, size_t shardsNum) {
+    size_t rangesNum = std::max<size_t>(1, std::min(shardsNum, sources.size()));
+    uint64_t total = 0;
+    for (auto &source : sources)
+        total += source.size;
+
+    std::vector<size_t> bounds(rangesNum + 1, 0);
+    bounds[rangesNum] = sources.size();
+    uint64_t bytes = 0;
+    size_t file = 0;
+    for (size_t range = 1; range < rangesNum; range++) {
+        ///< A range ends on the file that reaches its share of the bytes, every range keeps at least one file
+        uint64_t target = total * range / rangesNum;
+        while (file < sources.size() && bytes < target)
+            bytes += sources[file++].size;
+        file = std::max(file, bounds[range - 1] + 1);
+        file = std::min(file, sources.size() - (rangesNum - range));
+        bounds[range] = file;
+    }
+    return bounds;
+}
+
+std::vector<RelativeIndex> ShardCoordinator::mergeTops(const std::vector<std::vector<AbsoluteIndex>> &tops,
+                                                       size_t limit) {
+    std::vector<AbsoluteIndex> merged;
+    for (auto &top : tops)
+        merged.insert(merged.end(), top.begin(), top.end());
+    ///< The order of the heap of SearchServer: higher relevance first, then lower docId
+    std::sort(merged.begin(), merged.end(), [] (const AbsoluteIndex &a, const AbsoluteIndex &b) {
+        return a.absolute > b.absolute || (a.absolute == b.absolute && a.docId < b.docId);
+    });
+    if (merged.size() > limit)
+        merged.resize(limit);
+    return SearchServer::getRelative(merged, limit);
+}
+
+std::vector<size_t> ShardCoordinator::getOffsets(const std::vector<size_t> &docsAmounts) {
+    std::vector<size_t> offsets(docsAmounts.size(), 0);
+    for (size_t k = 1; k < docsAmounts.size(); k++)
+        offsets[k] = offsets[k - 1] + docsAmounts[k - 1];
+    return offsets;
+}
+
+std::vector<std::vector<RelativeIndex>> ShardCoordinator::search(const std::vector<std::string> &queriesInput) {
+    METRICS_TIME(MetricStage::SearchBatch);
+    std::vector<std::vector<RelativeIndex>> result(queriesInput.size());
+    if (queriesInput.empty())
+        return result;
+
+    ///< The batch is sent to all the shards before any answer is read, so they search it at the same time
+    std::string line = nlohmann::json({{"top", queriesInput}}).dump();
+    std::vector<std::future<std::string>> answers;
+    for (auto &shard : shards)
+        answers.push_back(send(*shard, line));
+
+    std::vector<std::vector<std::vector<AbsoluteIndex>>> tops(queriesInput.size(),
+                                                              std::vector<std::vector<AbsoluteIndex>>(shards.size()));
+    for (size_t k = 0; k < shards.size(); k++) {
+        nlohmann::json answer = nlohmann::json::parse(answers[k].get(), nullptr, false);
+        if (answer.is_discarded() || !answer["top"].is_array() || answer["top"].size() != queriesInput.size())
+            throw std::runtime_error("shard " + std::to_string(k) + " sent a wrong answer");
+        for (size_t i = 0; i < queriesInput.size(); i++) {
+            for (auto &document : answer["top"][i]) {
+                size_t docId = document[0];
+                tops[i][k].push_back({shards[k]->offset + docId, document[1]});
+            }
+        }
+    }
+    for (size_t i = 0; i < queriesInput.size(); i++)
+        result[i] = mergeTops(tops[i], limit);
+    return result;
+}
+
+#ifdef _WIN32
+
+ShardCoordinator::~ShardCoordinator() {}
+
+status ShardCoordinator::start(const std::vector<DocumentSource> &sources) {
+    std::cerr << "The shards are not supported on this system, set the shards field to 0" << std::endl;
+    return status::ERROR;
+}
+
+std::future<std::string> ShardCoordinator::send(Shard &shard, const std::string &line) {
+    std::promise<std::string> answer;
+    answer.set_exception(std::make_exception_ptr(std::runtime_error("the shards are not supported")));
+    return answer.get_future();
+}
+
+void ShardCoordinator::receive(Shard &shard) {}
+
+status ShardCoordinator::connectShard(Shard &shard) {
+    return status::ERROR;
+}
+
+#else
+
+ShardCoordinator::~ShardCoordinator() {
+    ///< The readers see the end of their connections, the workers are stopped
+    for (auto &shard : shards) {
+        if (shard->socket >= 0)
+            shutdown(shard->socket, SHUT_RDWR);
+        if (shard->pid > 0)
+            kill(shard->pid, SIGTERM);
+    }
+    for (auto &shard : shards) {
+        if (shard->pid > 0)
+            waitpid(shard->pid, nullptr, 0);
+        if (shard->reader.joinable())
+            shard->reader.join();
+        if (shard->socket >= 0)
+            close(shard->socket);
+        unlink(shard->path.c_str());
+    }
+}
+
+status ShardCoordinator::start(const std::vector<DocumentSource> &sources) {
+    limit = ConverterJSON::getResponsesLimit();
+    std::vector<size_t> bounds = splitFiles(sources, shardsNum);
+    const char *directory = std::getenv("TMPDIR");
+    std::string prefix = std::string(directory != nullptr && *directory != 0 ? directory : "/tmp") +
+                         "/search_engine." + std::to_string(getpid()) + ".";
+    pid_t parent = getpid();
+
+    for (size_t k = 0; k + 1 < bounds.size(); k++) {
+        std::unique_ptr<Shard> shard(new Shard);
+        shard->path = prefix + std::to_string(k) + ".sock";
+        unlink(shard->path.c_str());
+
+        ///< Only the calls that are safe in a forked copy of a multithreaded process are made before exec
+        std::vector<std::string> arguments = {executable, "--shard-worker", shard->path, std::to_string(k),
+                                              std::to_string(bounds[k]), std::to_string(bounds[k + 1])};
+        std::vector<char *> argv;
+        for (auto &argument : arguments)
+            argv.push_back(&argument[0]);
+        argv.push_back(nullptr);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent)
+                _exit(1);
+#endif
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        if (pid < 0) {
+            std::cerr << "Can't start the worker of shard " << k << ": " << std::strerror(errno) << std::endl;
+            return status::ERROR;
+        }
+        shard->pid = pid;
+        shards.push_back(std::move(shard));
+    }
+
+    ///< The workers build or load their indexes at the same time
+    std::vector<size_t> docsAmounts(shards.size());
+    for (size_t k = 0; k < shards.size(); k++) {
+        Shard &shard = *shards[k];
+        if (connectShard(shard) != status::OK) {
+            std::cerr << "The worker of shard " << k << " has quit" << std::endl;
+            return status::ERROR;
+        }
+        shard.reader = std::thread(&ShardCoordinator::receive, std::ref(shard));
+
+        nlohmann::json answer = nlohmann::json::parse(send(shard, R"({"command":"documents"})").get(),
+                                                      nullptr, false);
+        ///< A shard has fewer documents than files if some of its files can't be opened
+        if (answer.is_discarded() || !answer["documents"].is_number_unsigned() ||
+                answer["documents"] > bounds[k + 1] - bounds[k]) {
+            std::cerr << "Shard " << k << " has a wrong number of documents" << std::endl;
+            return status::ERROR;
+        }
+        docsAmounts[k] = answer["documents"];
+    }
+    std::vector<size_t> offsets = getOffsets(docsAmounts);
+    for (size_t k = 0; k < shards.size(); k++)
+        shards[k]->offset = offsets[k];
+    return status::OK;
+}
+
+status ShardCoordinator::connectShard(Shard &shard) {
+    sockaddr_un address{};
+    if (shard.path.size() >= sizeof(address.sun_path))
+        return status::ERROR;
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, shard.path.c_str());
+
+    ///< The worker listens only after its index is ready
+    for (;;) {
+        int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection < 0)
+            return status::ERROR;
+        if (connect(connection, (sockaddr *) &address, sizeof(address)) == 0) {
+            shard.socket = connection;
+            return status::OK;
+        }
+        close(connection);
+        if (waitpid(shard.pid, nullptr, WNOHANG) != 0) {
+            shard.pid = -1;
+            return status::ERROR;
+        }
+        usleep(10000);
+    }
+}
+
+std::future<std::string> ShardCoordinator::send(Shard &shard, const std::string &line) {
+    std::lock_guard<std::mutex> sendLock(shard.sendAccess);
+    std::future<std::string> answer;
+    {
+        std::lock_guard<std::mutex> lock(shard.pendingAccess);
+        std::promise<std::string> promise;
+        answer = promise.get_future();
+        if (shard.failed) {
+            promise.set_exception(std::make_exception_ptr(std::runtime_error("a shard has quit")));
+            return answer;
+        }
+        shard.pending.push_back(std::move(promise));
+    }
+
+    std::string data = line + '\n';
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t written = ::send(shard.socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            ///< The reader sees the end of the connection and fails the answers still expected
+            shutdown(shard.socket, SHUT_RDWR);
+            break;
+        }
+        sent += (size_t) written;
+    }
+    return answer;
+}
+
+void ShardCoordinator::receive(Shard &shard) {
+    std::string buffer;
+    size_t scanned = 0; //!< the bytes of the buffer known to have no line end
+    char block[65536];
+    for (;;) {
+        size_t end;
+        while ((end = buffer.find('\n', scanned)) != std::string::npos) {
+            {
+                std::lock_guard<std::mutex> lock(shard.pendingAccess);
+                if (!shard.pending.empty()) {
+                    shard.pending.front().set_value(buffer.substr(0, end));
+                    shard.pending.pop_front();
+                }
+            }
+            buffer.erase(0, end + 1);
+            scanned = 0;
+        }
+        scanned = buffer.size();
+        ssize_t received = recv(shard.socket, block, sizeof(block), 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+        buffer.append(block, (size_t) received);
+    }
+
+    std::lock_guard<std::mutex> lock(shard.pendingAccess);
+    shard.failed = true;
+    for (auto &promise : shard.pending)
+        promise.set_exception(std::make_exception_ptr(std::runtime_error("a shard has quit")));
+    shard.pending.clear();
+}
+
+#endif
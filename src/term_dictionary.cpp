@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstring>
+#include "term_dictionary.h"
+
+const uint32_t TermDictionary::npos;
+
+TermDictionary::TermDictionary() {
+    clear();
+}
+
+uint32_t TermDictionary::find(const char *data, size_t size) const {
+    return slots[findSlot(data, size, hash(data, size))];
+}
+
+uint32_t TermDictionary::insert(const char *data, size_t size) {
+    uint32_t termHash = hash(data, size);
+    size_t slot = findSlot(data, size, termHash);
+    if (slots[slot] != npos)
+        return slots[slot];
+
+    auto id = (uint32_t) hashes.size();
+    auto &chars = arena.modify();
+    chars.insert(chars.end(), data, data + size);
+    offsets.modify().push_back((uint32_t) chars.size());
+    hashes.modify().push_back(termHash);
+    slots.modify()[slot] = id;
+
+    ///< The table is kept at most half full, so probe sequences stay short
+    if (hashes.size() * 2 > slots.size())
+        grow();
+    return id;
+}
+
+std::string TermDictionary::getTerm(uint32_t id) const {
+    return std::string(arena.data() + offsets[id], arena.data() + offsets[id + 1]);
+}
+
+std::vector<uint32_t> TermDictionary::getSortedIds() const {
+    std::vector<uint32_t> ids(size());
+    for (uint32_t id = 0; id < ids.size(); id++)
+        ids[id] = id;
+    ///< The terms are compared in place in the arena, no string is created for a term
+    std::sort(ids.begin(), ids.end(), [this] (uint32_t a, uint32_t b) {
+        TextView termA = getTermView(a), termB = getTermView(b);
+        int result = std::memcmp(termA.data, termB.data, std::min(termA.size, termB.size));
+        return result < 0 || (result == 0 && termA.size < termB.size);
+    });
+    return ids;
+}
+
+void TermDictionary::clear() {
+    arena.clear();
+    offsets.clear();
+    offsets.modify().push_back(0);
+    hashes.clear();
+    slots.clear();
+    slots.modify().assign(16, npos);
+}
+
+void TermDictionary::shrinkToFit() {
+    arena.shrinkToFit();
+    offsets.shrinkToFit();
+    hashes.shrinkToFit();
+}
+
+void TermDictionary::writeTo(IndexFileWriter &writer) const {
+    writer.addSection(IndexSection::TermArena, arena);
+    writer.addSection(IndexSection::TermOffsets, offsets);
+    writer.addSection(IndexSection::TermHashes, hashes);
+    writer.addSection(IndexSection::TermSlots, slots);
+}
+
+bool TermDictionary::readFrom(const IndexFileReader &reader) {
+    if (!reader.attachSection(IndexSection::TermArena, arena) ||
+            !reader.attachSection(IndexSection::TermOffsets, offsets) ||
+            !reader.attachSection(IndexSection::TermHashes, hashes) ||
+            !reader.attachSection(IndexSection::TermSlots, slots))
+        return false;
+
+    bool isPowerOf2 = !slots.empty() && (slots.size() & (slots.size() - 1)) == 0;
+    if (!isPowerOf2 || offsets.size() != hashes.size() + 1 || hashes.size() * 2 > slots.size() ||
+            offsets[0] != 0 || offsets[offsets.size() - 1] != arena.size())
+        return false;
+
+    ///< The ids and the offsets are used without checks by the lookups, so a damaged table is rejected here.
+    ///< Every term has one slot, so the table keeps its empty slots and a lookup always stops.
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] < offsets[i - 1])
+            return false;
+    }
+    size_t usedSlots = 0;
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+        if (slots[slot] == npos)
+            continue;
+        if (slots[slot] >= hashes.size())
+            return false;
+        usedSlots++;
+    }
+    return usedSlots == hashes.size();
+}
+
+uint32_t TermDictionary::hash(const char *data, size_t size) {
+    ///< FNV-1a with a final avalanche, so that the low bits used for the slot depend on every character
+    uint64_t result = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        result ^= (unsigned char) data[i];
+        result *= 1099511628211ull;
+    }
+    result ^= result >> 32;
+    result *= 0xd6e8feb86659fd93ull;
+    result ^= result >> 32;
+    return (uint32_t) result;
+}
+
+size_t TermDictionary::findSlot(const char *data, size_t size, uint32_t termHash) const {
+    const uint32_t *table = slots.data();
+    const uint32_t *termHashes = hashes.data();
+    const uint32_t *termOffsets = offsets.data();
+    const char *chars = arena.data();
+    size_t mask = slots.size() - 1;
+    for (size_t slot = termHash & mask;; slot = (slot + 1) & mask) {
+        uint32_t id = table[slot];
+        if (id == npos)
+            return slot;
+        if (termHashes[id] == termHash && termOffsets[id + 1] - termOffsets[id] == size &&
+                (size == 0 || std::memcmp(chars + termOffsets[id], data, size) == 0))
+            return slot;
+    }
+}
+
+void TermDictionary::grow() {
+    auto &table = slots.modify();
+    table.assign(table.size() * 2, npos);
+    size_t mask = table.size() - 1;
+    for (uint32_t id = 0; id < hashes.size(); id++) {
+        size_t slot = hashes[id] & mask;
+        while (table[slot] != npos)
+            slot = (slot + 1) & mask;
+        table[slot] = id;
+    }
+}
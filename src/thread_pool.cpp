@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <exception>
+#include "thread_pool.h"
+#include "metrics.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace {
+/*!
+ * The pool and the id of the worker that runs on the current thread
+ */
+struct CurrentWorker {
+    const ThreadPool *pool = nullptr;
+    size_t id = 0;
+};
+
+thread_local CurrentWorker currentWorker;
+}
+
+ThreadPool::ThreadPool(size_t threadsNum, bool pinned) {
+    startWorkers(threadsNum, pinned);
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::setThreadsNumber(size_t threadsNum, bool pinned) {
+    stopWorkers();
+    startWorkers(threadsNum, pinned);
+}
+
+size_t ThreadPool::getThreadsNumber() const {
+    return workers.size();
+}
+
+void ThreadPool::startWorkers(size_t threadsNum, bool pinned) {
+    if (threadsNum == 0)
+        threadsNum = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+
+    stopping = false;
+    queues.clear();
+    for (size_t i = 0; i < threadsNum; i++)
+        queues.emplace_back(new WorkerQueue);
+
+    for (size_t i = 0; i < threadsNum; i++) {
+        workers.emplace_back([this, i, pinned]() {
+            if (pinned)
+                pinToCore(i);
+            workerLoop(i);
+        });
+    }
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(sleepAccess);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t queueId = currentWorkerId();
+    if (queueId >= queues.size())
+        queueId = nextQueue++ % queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(queues[queueId]->access);
+        queues[queueId]->tasks.push_back(std::move(task));
+    }
+    queuedTasks++;
+    {
+        ///< The lock guarantees that a worker checking for tasks either sees the new one or is already waiting
+        std::lock_guard<std::mutex> lock(sleepAccess);
+    }
+    wakeUp.notify_one();
+    callersWakeUp.notify_all();
+}
+
+void ThreadPool::parallelFor(size_t amount, const std::function<void(size_t)> &body, size_t maxTasks) {
+    if (amount == 0)
+        return;
+    size_t tasksNum = std::min(amount, workers.size() + 1);
+    if (maxTasks != 0)
+        tasksNum = std::min(tasksNum, maxTasks);
+
+    std::atomic<size_t> nextIndex(0);
+    std::atomic<size_t> pendingTasks(tasksNum - 1);
+    std::exception_ptr error;
+    std::mutex errorAccess;
+
+    auto loop = [&nextIndex, &body, &error, &errorAccess, amount]() {
+        try {
+            for (size_t i = nextIndex++; i < amount; i = nextIndex++)
+                body(i);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(errorAccess);
+            if (!error)
+                error = std::current_exception();
+            nextIndex = amount; ///< the other tasks stop claiming indexes
+        }
+    };
+
+    for (size_t i = 1; i < tasksNum; i++) {
+        submit([this, &loop, &pendingTasks]() {
+            loop();
+            {
+                ///< The caller checks the counter under the lock, so it can't miss the notification
+                std::lock_guard<std::mutex> lock(sleepAccess);
+                pendingTasks--; ///< the last access to the state of the caller
+            }
+            callersWakeUp.notify_all();
+        });
+    }
+    loop();
+
+    size_t self = currentWorkerId();
+    while (pendingTasks > 0) {
+        if (runPendingTask(self))
+            continue;
+        ///< The tasks left are running on other threads, the caller sleeps instead of spinning
+        std::unique_lock<std::mutex> lock(sleepAccess);
+        callersWakeUp.wait(lock, [this, &pendingTasks]() { return pendingTasks == 0 || queuedTasks > 0; });
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::workerLoop(size_t workerId) {
+    currentWorker.pool = this;
+    currentWorker.id = workerId;
+    while (true) {
+#ifdef SEARCH_ENGINE_METRICS
+        ///< The tasks run by a task waiting in parallelFor are inside its time, so they are not counted twice
+        auto taskStart = Metrics::clock_type::now();
+        if (runPendingTask(workerId)) {
+            METRICS_ADD_BUSY_TIME(Metrics::clock_type::now() - taskStart);
+            continue;
+        }
+#else
+        if (runPendingTask(workerId))
+            continue;
+#endif
+        std::unique_lock<std::mutex> lock(sleepAccess);
+        wakeUp.wait(lock, [this]() { return stopping || queuedTasks > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+bool ThreadPool::runPendingTask(size_t workerId) {
+    std::function<void()> task;
+    if (workerId < queues.size()) {
+        std::lock_guard<std::mutex> lock(queues[workerId]->access);
+        if (!queues[workerId]->tasks.empty()) {
+            task = std::move(queues[workerId]->tasks.back());
+            queues[workerId]->tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i <= queues.size(); i++) {
+        auto &victim = *queues[(workerId + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.access);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task)
+        return false;
+
+    queuedTasks--;
+    task();
+    return true;
+}
+
+size_t ThreadPool::currentWorkerId() const {
+    return currentWorker.pool == this ? currentWorker.id : queues.size();
+}
+
+void ThreadPool::pinToCore(size_t core) {
+    size_t coresNum = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core % coresNum, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << (core % coresNum));
+#else
+    (void) core;
+    (void) coresNum;
+#endif
+}
@@ -0,0 +1,168 @@
+#include <cstring>
+#include "tokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOKENIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENIZER_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const size_t Tokenizer::blockSize;
+
+namespace {
+inline unsigned countTrailingZeros(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (unsigned) index;
+#else
+    return (unsigned) __builtin_ctzll(bits);
+#endif
+}
+
+uint64_t getDelimiterMaskScalar(const char *block) {
+    uint64_t mask = 0;
+    for (unsigned i = 0; i < 64; i++)
+        mask |= (uint64_t) Tokenizer::isDelimiter(block[i]) << i;
+    return mask;
+}
+
+#ifdef TOKENIZER_SSE2
+inline uint64_t getDelimiterMask16(const char *block) {
+    __m128i chars = _mm_loadu_si128((const __m128i *) block);
+    __m128i spaces = _mm_cmpeq_epi8(chars, _mm_set1_epi8(' '));
+    ///< \t..\r are the only characters whose difference with \t is at most 4 as unsigned bytes
+    __m128i shifted = _mm_sub_epi8(chars, _mm_set1_epi8('\t'));
+    __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    return (uint64_t) (unsigned) _mm_movemask_epi8(_mm_or_si128(spaces, controls));
+}
+
+uint64_t getDelimiterMaskSSE2(const char *block) {
+    return getDelimiterMask16(block) | getDelimiterMask16(block + 16) << 16 |
+           getDelimiterMask16(block + 32) << 32 | getDelimiterMask16(block + 48) << 48;
+}
+#endif
+
+#ifdef TOKENIZER_AVX2
+__attribute__((target("avx2"))) inline uint64_t getDelimiterMask32(const char *block) {
+    __m256i chars = _mm256_loadu_si256((const __m256i *) block);
+    __m256i spaces = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' '));
+    __m256i shifted = _mm256_sub_epi8(chars, _mm256_set1_epi8('\t'));
+    __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+    return (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(spaces, controls));
+}
+
+__attribute__((target("avx2"))) uint64_t getDelimiterMaskAVX2(const char *block) {
+    return getDelimiterMask32(block) | getDelimiterMask32(block + 32) << 32;
+}
+#endif
+}
+
+Tokenizer::Tokenizer(TextView inText, bool inLowercase, ScannerType scanner)
+                    : text(inText.data), size(inText.size), lowercase(inLowercase) {
+    if (!isSupported(scanner))
+        scanner = ScannerType::Scalar;
+    switch (scanner) {
+#ifdef TOKENIZER_AVX2
+        case ScannerType::AVX2:
+            getDelimiterMask = getDelimiterMaskAVX2;
+            break;
+#endif
+#ifdef TOKENIZER_SSE2
+        case ScannerType::SSE2:
+            getDelimiterMask = getDelimiterMaskSSE2;
+            break;
+#endif
+        default:
+            getDelimiterMask = getDelimiterMaskScalar;
+    }
+    if (size != 0)
+        classifyBlock();
+}
+
+bool Tokenizer::next(TextView &word) {
+    size_t begin, end;
+    if (!find(false, begin))
+        return false;
+    find(true, end);
+    word = TextView(text + begin, end - begin);
+    if (!lowercase)
+        return true;
+
+    ///< Most words are already in lowercase, only the others are copied
+    size_t i = 0;
+    while (i < word.size && (unsigned char) (word.data[i] - 'A') > 'Z' - 'A')
+        i++;
+    if (i == word.size)
+        return true;
+    lowered.assign(word.data, word.size);
+    for (; i < lowered.size(); i++) {
+        if ((unsigned char) (lowered[i] - 'A') <= 'Z' - 'A')
+            lowered[i] = (char) (lowered[i] - 'A' + 'a');
+    }
+    word = TextView(lowered);
+    return true;
+}
+
+bool Tokenizer::find(bool isDelimiter, size_t &position) {
+    while (blockBegin < size) {
+        uint64_t found = isDelimiter ? delimiters : ~delimiters;
+        found = offset < blockSize ? found & (~(uint64_t) 0 << offset) : 0;
+        if (found != 0) {
+            offset = countTrailingZeros(found);
+            position = blockBegin + offset;
+            return true;
+        }
+        blockBegin += blockSize;
+        offset = 0;
+        if (blockBegin < size)
+            classifyBlock();
+    }
+    position = size;
+    return false;
+}
+
+void Tokenizer::classifyBlock() {
+    if (size - blockBegin >= blockSize) {
+        delimiters = getDelimiterMask(text + blockBegin);
+        return;
+    }
+    ///< The end of the text is padded with delimiters, so the last word ends at the end of the text
+    char block[blockSize];
+    std::memset(block, ' ', blockSize);
+    std::memcpy(block, text + blockBegin, size - blockBegin);
+    delimiters = getDelimiterMask(block);
+}
+
+ScannerType Tokenizer::getBestScanner() {
+    static const ScannerType best = isSupported(ScannerType::AVX2) ? ScannerType::AVX2 :
+                                    isSupported(ScannerType::SSE2) ? ScannerType::SSE2 : ScannerType::Scalar;
+    return best;
+}
+
+bool Tokenizer::isSupported(ScannerType scanner) {
+    switch (scanner) {
+        case ScannerType::AVX2:
+#ifdef TOKENIZER_AVX2
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case ScannerType::SSE2:
+#ifdef TOKENIZER_SSE2
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
@@ -1,5 +1,23 @@
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <functional>
 #include "gtest/gtest.h"
 #include "search_server.h"
+#include "converter_json.h"
+#include "thread_pool.h"
+#include "file_exchange.h"
+#include "ingest_pipeline.h"
+#include "tokenizer.h"
+#include "query_daemon.h"
+#include "shard_coordinator.h"
+#include "metrics.h"
+#include "posting_arena.h"
 
 //Test for InvertedIndex class-------
 void TestInvertedIndexFunctionality(
@@ -66,6 +84,240 @@ TEST(TestCaseInvertedIndex, TestInvertedIndexMissingWord) {
     };
     TestInvertedIndexFunctionality(docs, requests, expected);
 }
+
+TEST(TestCaseInvertedIndex, TestPostingsSortedByDocId) {
+    std::vector<std::string> docs;
+    std::vector<Entry> expectedCommon, expectedLast;
+    for (size_t i = 0; i < 100; i++) {
+        docs.push_back("common " + std::to_string(i) + (i % 3 == 0 ? " common" : "") + " last");
+        expectedCommon.push_back({i, i % 3 == 0 ? 2u : 1u});
+        expectedLast.push_back({i, 1});
+    }
+    const std::vector<std::string> requests = {"common", "last", "42"};
+    const std::vector<std::vector<Entry>> expected = {expectedCommon, expectedLast, {{42, 1}}};
+    TestInvertedIndexFunctionality(docs, requests, expected);
+}
+
+TEST(TestCaseInvertedIndex, TestPostingsView) {
+    const std::vector<std::string> docs = {
+            "milk milk milk milk water water water",
+            "milk water water",
+            "americano cappuccino"
+    };
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+    PostingList water = idx.getSegment(0).getPostings("water");
+    ASSERT_EQ(water.docFrequency, 2);
+    ASSERT_EQ(water.totalCount, 5);
+    ASSERT_EQ(water.decode(), (std::vector<Entry>{{0, 3}, {1, 2}}));
+    ASSERT_TRUE(idx.getSegment(0).getPostings("sugar").empty());
+}
+
+TEST(TestCaseInvertedIndex, TestSkewedCorpus) {
+    ///< One document of about 1.2 MB among many small ones, the large one is split into chunks
+    std::mt19937 random(7);
+    std::vector<std::string> docs(1000);
+    for (size_t i = 0; i < 200000; i++)
+        docs[0] += "w" + std::to_string(random() % 1000) + (i % 10 == 9 ? "\n" : " ");
+    for (size_t docId = 1; docId < docs.size(); docId++) {
+        for (size_t i = 0; i < 10; i++)
+            docs[docId] += "w" + std::to_string(random() % 1000) + ' ';
+    }
+
+    std::map<std::string, std::vector<Entry>> expected;
+    for (size_t docId = 0; docId < docs.size(); docId++) {
+        std::map<std::string, size_t> counts;
+        std::stringstream docStream(docs[docId]);
+        for (std::string word; docStream >> word;)
+            counts[word]++;
+        for (auto &count : counts)
+            expected[count.first].push_back({docId, count.second});
+    }
+
+    const size_t chunkSize = 64 * 1024;
+    auto chunks = InvertedIndex::getChunks(std::vector<TextView>(docs.begin(), docs.end()), chunkSize);
+    size_t largeChunks = std::count_if(chunks.begin(), chunks.end(), [](const InvertedIndex::TextChunk &chunk) {
+        return chunk.docId == 0;
+    });
+    ASSERT_GT(largeChunks, 1);
+    ASSERT_EQ(chunks.size(), largeChunks + docs.size() - 1);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        size_t docId = chunks[i].docId;
+        ASSERT_EQ(chunks[i].begin, i == 0 || chunks[i - 1].docId != docId ? 0 : chunks[i - 1].end);
+        if (i + 1 == chunks.size() || chunks[i + 1].docId != docId)
+            ASSERT_EQ(chunks[i].end, docs[docId].size());
+        else
+            ASSERT_TRUE(docs[docId][chunks[i].end] == ' ' || docs[docId][chunks[i].end] == '\n');
+    }
+
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+    for (auto &record : expected)
+        ASSERT_EQ(idx.getWordCount(record.first), record.second) << record.first;
+}
+TEST(TestCaseInvertedIndex, TestUpdatesMatchRebuild) {
+    std::mt19937 random(11);
+    auto makeDoc = [&random] () {
+        std::string doc;
+        for (int i = 0; i < 30; i++)
+            doc += "w" + std::to_string(random() % (i % 3 == 0 ? 5 : 200)) + " ";
+        return doc;
+    };
+    std::vector<std::string> docs(200);
+    for (auto &doc : docs)
+        doc = makeDoc();
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+
+    const std::vector<std::string> requests = {"w0 w1", "w7 w150", "w3 w4 w199", "w42"};
+    for (int step = 0; step < 60; step++) {
+        std::vector<size_t> updatedIds, removedIds;
+        std::vector<std::string> updatedDocs;
+        for (int i = 0; i < 5; i++) {
+            ///< Some of the ids are past the end of the base, they add new documents
+            size_t docId = random() % (docs.size() + 3);
+            if (docId >= docs.size())
+                docs.resize(docId + 1);
+            if (random() % 4 == 0) {
+                removedIds.push_back(docId);
+                docs[docId].clear();
+            } else {
+                updatedIds.push_back(docId);
+                updatedDocs.push_back(makeDoc());
+                docs[docId] = updatedDocs.back();
+            }
+        }
+        idx.updateDocuments(updatedIds, updatedDocs);
+        idx.removeDocuments(removedIds);
+        if (step % 20 == 19)
+            idx.waitForMerges();
+
+        ///< A removed document is the same as an empty one for the full rebuild
+        InvertedIndex rebuilt;
+        rebuilt.updateDocumentBase(docs);
+        for (int word = 0; word < 200; word++) {
+            std::string term = "w" + std::to_string(word);
+            ASSERT_EQ(idx.getWordCount(term), rebuilt.getWordCount(term)) << term << " at step " << step;
+        }
+        ASSERT_EQ(SearchServer(idx).search(requests), SearchServer(rebuilt).search(requests)) << "at step " << step;
+    }
+    idx.waitForMerges();
+    ASSERT_LT(idx.getSegmentsNum(), 8);
+}
+
+TEST(TestCaseInvertedIndex, TestMemoryStats) {
+    InvertedIndex idx;
+    idx.updateDocumentBase({"milk milk water", "milk sugar", "milk water salt", "bread"});
+    IndexMemoryStats stats = idx.getMemoryStats(2);
+
+    ASSERT_EQ(stats.docsAmount, 4);
+    ASSERT_EQ(stats.vocabularySize, 5);
+    ASSERT_EQ(stats.postingsNum, 3 + 2 + 1 + 1 + 1);
+    ///< milk is in 3 documents (bucket 1), water in 2 (bucket 1), the rest in 1 (bucket 0)
+    const std::vector<size_t> expectedHistogram = {3, 2};
+    ASSERT_EQ(stats.docFrequencyHistogram, expectedHistogram);
+    ASSERT_EQ(stats.longestPostings.size(), 2);
+    ASSERT_EQ(stats.longestPostings[0].term, "milk");
+    ASSERT_EQ(stats.longestPostings[0].docFrequency, 3);
+    ASSERT_EQ(stats.longestPostings[1].term, "water");
+
+    ///< The arrays of the index are counted by the allocator of the whole process
+    ASSERT_GT(stats.dictionary.allocated, 0);
+    ASSERT_GT(stats.postings.allocated, 0);
+    ASSERT_GE(MemoryAccounting::getAllocatedBytes(MemoryCategory::Dictionary), stats.dictionary.allocated);
+    ASSERT_GE(MemoryAccounting::getAllocatedBytes(MemoryCategory::Postings), stats.postings.allocated);
+    size_t before = MemoryAccounting::getAllocatedBytes(MemoryCategory::Postings);
+    idx.updateDocumentBase({"bread"});
+    ASSERT_LT(MemoryAccounting::getAllocatedBytes(MemoryCategory::Postings), before);
+}
+
+/*!
+ * The function counts the matches of a phrase in a document by trying every chain of positions
+ * @param [in] doc the words of the document
+ * @param [in] phrase the words of the phrase
+ * @param [in] slop the highest number of other words between two words of the phrase
+ * @return number of the positions of the first word that begin a match
+ */
+size_t countPhrase(const std::vector<std::string> &doc, const std::vector<std::string> &phrase, size_t slop) {
+    std::function<bool(size_t, size_t)> matches = [&] (size_t word, size_t position) {
+        if (word == phrase.size())
+            return true;
+        for (size_t next = position + 1; next < doc.size() && next <= position + 1 + slop; next++) {
+            if (doc[next] == phrase[word] && matches(word + 1, next))
+                return true;
+        }
+        return false;
+    };
+    size_t found = 0;
+    for (size_t position = 0; position < doc.size(); position++)
+        found += doc[position] == phrase[0] && matches(1, position);
+    return found;
+}
+
+TEST(TestCaseInvertedIndex, TestPositionsMatchBruteForce) {
+    std::mt19937 random(5);
+    auto makeDoc = [&random] () {
+        std::vector<std::string> doc(random() % 40);
+        for (auto &word : doc)
+            word = "w" + std::to_string(random() % 6);
+        return doc;
+    };
+    auto join = [] (const std::vector<std::string> &doc) {
+        std::string text;
+        for (auto &word : doc)
+            text += word + (text.size() % 3 == 0 ? "\n" : "  ");
+        return text;
+    };
+    std::vector<std::vector<std::string>> docs(300);
+    std::vector<std::string> texts;
+    for (auto &doc : docs) {
+        doc = makeDoc();
+        texts.push_back(join(doc));
+    }
+    InvertedIndex idx;
+    idx.setPositions(true);
+    idx.updateDocumentBase(texts);
+    ///< The updates add segments with positions, the merges and the saved file must keep them
+    for (int step = 0; step < 30; step++) {
+        size_t docId = random() % docs.size();
+        docs[docId] = makeDoc();
+        idx.updateDocuments({docId}, {join(docs[docId])});
+    }
+    idx.waitForMerges();
+    const std::string path = "test_positions.bin";
+    ASSERT_EQ(idx.save(path), status::OK);
+    auto loaded = std::make_shared<InvertedIndex>();
+    ASSERT_EQ(loaded->load(path, true), status::OK);
+    ASSERT_TRUE(loaded->hasPositions());
+
+    SearchServer srv(loaded);
+    srv.search({}); ///< the first search loads the configuration
+    size_t limit = ConverterJSON::getResponsesLimit();
+    for (int query = 0; query < 40; query++) {
+        std::vector<std::string> phrase(2 + random() % 2);
+        for (auto &word : phrase)
+            word = "w" + std::to_string(random() % 6);
+        size_t slop = query % 2 == 0 ? 0 : random() % 3;
+        std::string request = "\"" + phrase[0];
+        for (size_t i = 1; i < phrase.size(); i++)
+            request += " " + phrase[i];
+        request += "\"" + (slop != 0 ? "~" + std::to_string(slop) : "");
+
+        std::vector<AbsoluteIndex> expected;
+        for (size_t docId = 0; docId < docs.size(); docId++) {
+            size_t found = countPhrase(docs[docId], phrase, slop);
+            if (found != 0)
+                expected.push_back({docId, found});
+        }
+        std::stable_sort(expected.begin(), expected.end(), [] (const AbsoluteIndex &a, const AbsoluteIndex &b) {
+            return a.absolute > b.absolute;
+        });
+        if (expected.size() > limit)
+            expected.resize(limit);
+        ASSERT_EQ(srv.searchAbsolute({request})[0], expected) << request;
+    }
+    std::remove(path.c_str());
+}
 //-----------------------------------
 
 //Test for SearchServer class--------
@@ -133,4 +385,822 @@ TEST(TestCaseSearchServer, TestTop5) {
     std::vector<std::vector<RelativeIndex>> result = srv.search(request);
     ASSERT_EQ(result, expected);
 }
+TEST(TestCaseSearchServer, TestTopMatchesFullRanking) {
+    std::mt19937 random(2023);
+    std::vector<std::string> words;
+    for (int i = 0; i < 40; i++)
+        words.push_back("w" + std::to_string(i));
+    ///< low word numbers are much more frequent, like "the" or "of" in real texts
+    auto randomWord = [&random, &words] () {
+        return words[std::min(random() % words.size(), random() % words.size())];
+    };
+
+    std::vector<std::string> docs(300);
+    for (auto &doc : docs) {
+        for (size_t i = random() % 30; i > 0; i--)
+            doc += randomWord() + ' ';
+        doc += randomWord();
+    }
+    std::vector<std::string> requests(100);
+    for (auto &request : requests) {
+        for (size_t i = random() % 4; i > 0; i--)
+            request += randomWord() + ' ';
+        request += randomWord();
+    }
+
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+    SearchServer srv(idx);
+    std::vector<std::vector<RelativeIndex>> result = srv.search(requests);
+
+    ASSERT_EQ(result.size(), requests.size());
+    for (size_t r = 0; r < requests.size(); r++) {
+        std::vector<std::string> requestWords;
+        std::stringstream requestStream(requests[r]);
+        for (std::string word; requestStream >> word;) {
+            if (std::find(requestWords.begin(), requestWords.end(), word) == requestWords.end())
+                requestWords.push_back(word);
+        }
+        std::vector<size_t> absolutes(docs.size(), 0);
+        for (auto &word : requestWords) {
+            for (auto &entry : idx.getWordCount(word))
+                absolutes[entry.docId] += entry.count;
+        }
+        size_t max = *std::max_element(absolutes.begin(), absolutes.end());
+        std::vector<RelativeIndex> expected;
+        for (size_t docId = 0; docId < docs.size(); docId++) {
+            if (absolutes[docId] != 0)
+                expected.push_back({docId, (double) absolutes[docId] / (double) max});
+        }
+        std::stable_sort(expected.begin(), expected.end(), [] (const RelativeIndex &a, const RelativeIndex &b) {
+            return a.rank > b.rank;
+        });
+        if (expected.size() > 5)
+            expected.resize(5);
+        ASSERT_EQ(result[r], expected) << requests[r];
+    }
+}
+TEST(TestCaseSearchServer, TestParallelBatchKeepsOrder) {
+    std::vector<std::string> docs;
+    for (int i = 0; i < 50; i++)
+        docs.push_back("doc" + std::to_string(i) + " word" + std::to_string(i % 7) + " word" + std::to_string(i % 5));
+    std::vector<std::string> requests;
+    for (int i = 0; i < 500; i++)
+        requests.push_back("word" + std::to_string(i % 9) + " doc" + std::to_string(i % 60));
+
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+    SearchServer srv(idx);
+    auto expected = srv.search(requests); ///< the first search loads the configuration
+
+    auto configuredThreads = JSON::config["config"]["search_threads"];
+    JSON::config["config"]["search_threads"] = 1;
+    auto sequential = srv.search(requests);
+    JSON::config["config"]["search_threads"] = 8;
+    auto parallel = srv.search(requests);
+    JSON::config["config"]["search_threads"] = configuredThreads;
+
+    ASSERT_EQ(sequential, expected);
+    ASSERT_EQ(parallel, expected);
+}
+
+TEST(TestCaseSearchServer, TestSnapshotSwap) {
+    auto first = std::make_shared<InvertedIndex>();
+    first->updateDocumentBase({"milk water", "sugar", "milk sugar"});
+    SearchServer srv(first);
+    const std::vector<std::string> requests = {"milk sugar", "water"};
+    auto before = srv.search(requests);
+    InvertedIndex rebuilt;
+    rebuilt.updateDocumentBase({"milk water", "milk milk milk", "milk sugar"});
+    auto after = SearchServer(rebuilt).search(requests);
+    ASSERT_NE(before, after);
+
+    ///< The next snapshot shares the segments of the current one, the searches keep running while it is published
+    std::atomic<bool> published(false);
+    std::atomic<size_t> mixed(0);
+    std::thread searcher([&]() {
+        for (bool done = false; !done;) {
+            done = published;
+            auto result = srv.search(requests);
+            if (result != before && result != after)
+                mixed++;
+        }
+    });
+    auto second = std::make_shared<InvertedIndex>(*srv.getIndex());
+    second->updateDocuments({1}, {"milk milk milk"});
+    auto held = srv.getIndex();
+    srv.setIndex(second);
+    published = true;
+    searcher.join();
+
+    ASSERT_EQ(mixed, 0);
+    ASSERT_EQ(srv.search(requests), after);
+    ASSERT_EQ(SearchServer(held).search(requests), before);
+    ASSERT_EQ(first->getWordCount("sugar"), std::vector<Entry>({{1, 1}, {2, 1}}));
+}
+
+TEST(TestCaseSearchServer, TestResultCache) {
+    InvertedIndex idx;
+    idx.updateDocumentBase({"milk water", "milk sugar", "water water"});
+    SearchServer srv(idx);
+    srv.search({}); ///< the first search loads the configuration
+    auto configured = JSON::config["config"];
+    JSON::config["config"]["search_threads"] = 1;
+    JSON::config["config"]["cache_capacity"] = 0;
+    const std::vector<std::string> requests = {"milk water", "water  milk milk", "sugar", "milk water"};
+    auto uncached = srv.search(requests);
+    ASSERT_EQ(srv.getCacheStats().hits, 0);
+
+    JSON::config["config"]["cache_capacity"] = 8;
+    ASSERT_EQ(srv.search(requests), uncached);
+    CacheStats stats = srv.getCacheStats();
+    ASSERT_EQ(stats.hits, 2);
+    ASSERT_EQ(stats.size, 2);
+    ASSERT_EQ(srv.search(requests), uncached);
+    ASSERT_EQ(srv.getCacheStats().hits, 6);
+
+    ///< A new snapshot is searched, not the cached results of the old one
+    auto next = std::make_shared<InvertedIndex>(*srv.getIndex());
+    next->removeDocuments({0});
+    srv.setIndex(next);
+    stats = srv.getCacheStats();
+    auto result = srv.search({"milk water"});
+    ASSERT_EQ(srv.search({"milk water"}), result);
+    JSON::config["config"] = configured;
+    ASSERT_EQ(result, std::vector<std::vector<RelativeIndex>>({{{2, 1}, {1, 0.5}}}));
+    ASSERT_EQ(srv.getCacheStats().hits, stats.hits + 1);
+    ASSERT_EQ(srv.getCacheStats().misses, stats.misses + 1);
+}
+
+TEST(TestCaseSearchServer, TestPhraseQueries) {
+    const std::vector<std::string> docs = {
+            "milk water milk water",
+            "water milk sugar water",
+            "milk sugar water",
+            "milk and sugar and water"
+    };
+    InvertedIndex idx;
+    idx.setPositions(true);
+    idx.updateDocumentBase(docs);
+    SearchServer srv(idx);
+    const std::vector<std::string> requests = {"\"milk water\"", "\"milk water\"~1", "\"milk water\"~3 \"sugar\"",
+                                               "\"milk water", "\"water milk\" sugar"};
+    const std::vector<std::vector<RelativeIndex>> expected = {
+            {{0, 1}},
+            {{0, 1}, {1, 0.5}, {2, 0.5}},
+            {{0, 1}, {1, 1}, {2, 1}, {3, 1}},
+            {{0, 1}, {1, 0.75}, {2, 0.5}, {3, 0.5}},
+            {{1, 1}, {0, 0.5}, {2, 0.5}, {3, 0.5}}
+    };
+    ASSERT_EQ(srv.search(requests), expected);
+
+    ///< Without positions the quotes are a part of the words
+    InvertedIndex plain;
+    plain.updateDocumentBase(docs);
+    ASSERT_EQ(SearchServer(plain).search({"\"milk water\""}), std::vector<std::vector<RelativeIndex>>({{}}));
+}
+//-----------------------------------
+
+//Test for QueryDaemon class---------
+TEST(TestCaseQueryDaemon, TestPipelinedAnswersKeepOrder) {
+    InvertedIndex idx;
+    idx.updateDocumentBase({"milk water", "milk sugar", "water water"});
+    SearchServer srv(idx);
+    std::vector<std::string> requests;
+    for (int i = 0; i < 200; i++)
+        requests.push_back(i % 3 == 0 ? "milk water" : i % 3 == 1 ? "sugar" : "london");
+    auto expected = SearchServer::convert(srv.search(requests));
+
+    std::vector<std::string> lines = {"", "{\"requests\": 5}", "not json"};
+    for (auto &request : requests)
+        lines.push_back(nlohmann::json({{"requests", {request}}}).dump());
+    size_t nextLine = 0;
+    std::vector<std::string> answers;
+    QueryDaemon daemon(srv, 8);
+    daemon.serveConnection([&lines, &nextLine](std::string &line) {
+        if (nextLine == lines.size())
+            return false;
+        line = lines[nextLine++];
+        return true;
+    }, [&answers](const std::string &line) {
+        answers.push_back(line);
+        return true;
+    });
+
+    ///< The empty line is skipped, the broken ones get an error, the rest are answered in the order of the lines
+    ASSERT_EQ(answers.size(), requests.size() + 2);
+    ASSERT_TRUE(nlohmann::json::parse(answers[0]).contains("error"));
+    ASSERT_TRUE(nlohmann::json::parse(answers[1]).contains("error"));
+    for (size_t i = 0; i < requests.size(); i++) {
+        auto answer = nlohmann::json::parse(answers[i + 2]);
+        ASSERT_EQ(answer, ConverterJSON::getAnswersJson({expected[i]})) << i;
+    }
+    ASSERT_EQ(daemon.processLine("{\"requests\": []}"), "{\"answers\":[]}");
+}
+//-----------------------------------
+
+//Test for ShardCoordinator class----
+TEST(TestCaseShardCoordinator, TestMergedShardsMatchOneIndex) {
+    std::mt19937 random(2023);
+    std::vector<std::string> docs;
+    for (int i = 0; i < 300; i++) {
+        std::string doc;
+        ///< Few words and short documents give many documents with equal relevance
+        for (int j = 0; j < 6; j++)
+            doc += "w" + std::to_string(random() % 8 * (random() % 3)) + " ";
+        docs.push_back(doc);
+    }
+    std::vector<std::string> requests = {"w0", "w0 w2", "w4 w6 w8", "w14 w7", "w10 w12 w14", "london"};
+    InvertedIndex idx;
+    idx.updateDocumentBase(docs);
+    auto expected = SearchServer(idx).search(requests);
+
+    const std::vector<size_t> bounds = {0, 97, 98, 210, 300};
+    std::vector<std::vector<std::vector<AbsoluteIndex>>> tops(requests.size());
+    for (size_t k = 0; k + 1 < bounds.size(); k++) {
+        InvertedIndex shardIdx;
+        shardIdx.updateDocumentBase(std::vector<std::string>(docs.begin() + bounds[k], docs.begin() + bounds[k + 1]));
+        auto shardTops = SearchServer(shardIdx).searchAbsolute(requests);
+        for (size_t i = 0; i < requests.size(); i++) {
+            for (auto &document : shardTops[i])
+                document.docId += bounds[k];
+            tops[i].push_back(shardTops[i]);
+        }
+    }
+    for (size_t i = 0; i < requests.size(); i++)
+        ASSERT_EQ(ShardCoordinator::mergeTops(tops[i], ConverterJSON::getResponsesLimit()), expected[i]) << i;
+}
+TEST(TestCaseShardCoordinator, TestMissingFileKeepsDocIds) {
+    std::mt19937 random(5);
+    std::vector<std::string> paths;
+    for (int i = 0; i < 12; i++) {
+        std::string doc;
+        for (int j = 0; j < 8; j++)
+            doc += "w" + std::to_string(random() % 10) + " ";
+        paths.push_back("test_shard" + std::to_string(i) + ".txt");
+        std::ofstream(paths.back(), std::ios::binary | std::ios::trunc) << doc;
+    }
+    ///< The missing files get no docIds, in the single index and in the shards
+    paths.insert(paths.begin() + 1, "test_shard_missing0.txt");
+    paths.insert(paths.begin() + 7, "test_shard_missing1.txt");
+    std::vector<std::string> requests = {"w0", "w1 w2", "w3 w5 w7", "w9 w4"};
+    InvertedIndex single;
+    IngestPipeline(IngestSettings()).run(paths, single);
+    auto expected = SearchServer(single).search(requests);
+
+    const std::vector<size_t> bounds = {0, 4, 8, paths.size()};
+    std::vector<size_t> docsAmounts;
+    std::vector<std::vector<std::vector<AbsoluteIndex>>> shardTops;
+    for (size_t k = 0; k + 1 < bounds.size(); k++) {
+        InvertedIndex shardIdx;
+        IngestPipeline(IngestSettings()).run(std::vector<std::string>(paths.begin() + bounds[k],
+                                                                      paths.begin() + bounds[k + 1]), shardIdx);
+        docsAmounts.push_back(shardIdx.getDocsAmount());
+        shardTops.push_back(SearchServer(shardIdx).searchAbsolute(requests));
+    }
+    ASSERT_EQ(docsAmounts, std::vector<size_t>({3, 3, 6}));
+    auto offsets = ShardCoordinator::getOffsets(docsAmounts);
+    for (size_t i = 0; i < requests.size(); i++) {
+        std::vector<std::vector<AbsoluteIndex>> tops;
+        for (size_t k = 0; k < shardTops.size(); k++) {
+            for (auto &document : shardTops[k][i])
+                document.docId += offsets[k];
+            tops.push_back(shardTops[k][i]);
+        }
+        ASSERT_EQ(ShardCoordinator::mergeTops(tops, ConverterJSON::getResponsesLimit()), expected[i]) << i;
+    }
+    for (auto &path : paths)
+        std::remove(path.c_str());
+}
+TEST(TestCaseShardCoordinator, TestSplitFilesBySize) {
+    std::vector<DocumentSource> sources(6);
+    const uint64_t sizes[] = {100, 10, 10, 10, 60, 10};
+    for (size_t i = 0; i < sources.size(); i++)
+        sources[i].size = sizes[i];
+    ASSERT_EQ(ShardCoordinator::splitFiles(sources, 2), std::vector<size_t>({0, 1, 6}));
+    ASSERT_EQ(ShardCoordinator::splitFiles(sources, 3), std::vector<size_t>({0, 1, 5, 6}));
+    ASSERT_EQ(ShardCoordinator::splitFiles(sources, 1), std::vector<size_t>({0, 6}));
+    ///< There are no empty shards
+    ASSERT_EQ(ShardCoordinator::splitFiles(sources, 10).size(), sources.size() + 1);
+    ASSERT_EQ(ShardCoordinator::splitFiles(std::vector<DocumentSource>(sources.begin(), sources.begin() + 2), 3),
+              std::vector<size_t>({0, 1, 2}));
+}
+//-----------------------------------
+
+//Test for PostingStore class--------
+TEST(TestCasePostingStore, TestCursorSeek) {
+    std::mt19937 random(11);
+    std::vector<Entry> entries;
+    for (size_t docId = 0; entries.size() < 1000; docId += 2 + random() % 300)
+        entries.push_back({docId, 1 + random() % 100000});
+    PostingStore store;
+    store.append({{5, 1}});
+    store.append(entries);
+    PostingList postings = store.getPostings(1);
+    ASSERT_EQ(postings.decode(), entries);
+    ASSERT_EQ(store.getPostings(0).decode(), (std::vector<Entry>{{5, 1}}));
+
+    PostingCursor cursor(postings);
+    for (size_t i = 0; i < entries.size(); i += 1 + random() % 200) {
+        size_t target = entries[i].docId - (i > 0 && random() % 2 ? 1 : 0);
+        cursor.seek((uint32_t) target);
+        ASSERT_FALSE(cursor.isEnd());
+        ASSERT_EQ(cursor.docId(), entries[i].docId);
+        ASSERT_EQ(cursor.count(), entries[i].count);
+    }
+    cursor.seek((uint32_t) entries.back().docId + 1);
+    ASSERT_TRUE(cursor.isEnd());
+}
+//-----------------------------------
+
+//Test for PostingArena class--------
+TEST(TestCasePostingArena, TestChunksKeepOrder) {
+    PostingArena arena;
+    ///< Term 0 grows over many chunks and pages, term 1 interleaves with it
+    for (uint32_t docId = 0; docId < 100000; docId++) {
+        arena.add(0, docId, 1);
+        if (docId % 3 == 0)
+            arena.add(1, docId, 2);
+    }
+    arena.add(1, 99999, 5);
+    arena.add(1, 99999, 1);
+    ASSERT_EQ(arena.size(), 2);
+    ASSERT_GT(MemoryAccounting::getAllocatedBytes(MemoryCategory::Build), 0);
+
+    std::vector<Entry> entries;
+    arena.appendTo(0, entries);
+    ASSERT_EQ(entries.size(), 100000);
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        ASSERT_EQ(entries[i].docId, i);
+        ASSERT_EQ(entries[i].count, 1);
+    }
+    entries.clear();
+    arena.appendTo(1, entries);
+    ///< The postings of the last document are summed up
+    ASSERT_EQ(entries.size(), 33334);
+    ASSERT_EQ(entries[1].docId, 3);
+    ASSERT_EQ(entries.back().docId, 99999);
+    ASSERT_EQ(entries.back().count, 2 + 5 + 1);
+
+    arena.clear();
+    ASSERT_EQ(arena.size(), 0);
+    ASSERT_EQ(MemoryAccounting::getAllocatedBytes(MemoryCategory::Build), 0);
+}
+//-----------------------------------
+
+//Test for TermDictionary class------
+TEST(TestCaseTermDictionary, TestInternsTerms) {
+    TermDictionary terms;
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; i++)
+        words.push_back("term" + std::to_string(i));
+    for (size_t i = 0; i < words.size(); i++)
+        ASSERT_EQ(terms.insert(words[i]), i);
+    for (size_t i = 0; i < words.size(); i++) {
+        ASSERT_EQ(terms.insert(words[i]), i);
+        ASSERT_EQ(terms.find(words[i]), i);
+        ASSERT_EQ(terms.getTerm((uint32_t) i), words[i]);
+    }
+    ASSERT_EQ(terms.size(), words.size());
+    ASSERT_EQ(terms.find("term1000"), TermDictionary::npos);
+    ASSERT_EQ(terms.find(""), TermDictionary::npos);
+}
+//-----------------------------------
+
+//Test for Tokenizer class-----------
+TEST(TestCaseTokenizer, TestScannersMatchIsspace) {
+    for (int c = 0; c < 256; c++)
+        ASSERT_EQ(Tokenizer::isDelimiter((char) c), std::isspace(c) != 0) << c;
+
+    std::mt19937 random(5);
+    const std::string alphabet = "ab \t\n\r\v\fZ\x80\xff";
+    for (size_t size = 0; size < 300; size++) {
+        std::string text;
+        for (size_t i = 0; i < size; i++)
+            text += alphabet[random() % alphabet.size()];
+        ///< Words split by std::isspace are the reference
+        std::vector<std::string> expected;
+        std::istringstream stream(text);
+        for (std::string word; stream >> word;)
+            expected.push_back(word);
+
+        for (auto scanner : {ScannerType::Scalar, ScannerType::SSE2, ScannerType::AVX2}) {
+            std::vector<std::string> words;
+            Tokenizer tokenizer(text, false, scanner);
+            TextView word;
+            while (tokenizer.next(word))
+                words.emplace_back(word.data, word.size);
+            ASSERT_EQ(words, expected) << "size " << size << " scanner " << (int) scanner;
+        }
+    }
+}
+
+TEST(TestCaseTokenizer, TestLowercase) {
+    std::vector<std::string> words;
+    const std::string text = "Great GREAT great\xc3\x89t\xc3\xa9 mIlK";
+    Tokenizer tokenizer(text, true);
+    TextView word;
+    while (tokenizer.next(word))
+        words.emplace_back(word.data, word.size);
+    ASSERT_EQ(words, std::vector<std::string>({"great", "great", "great\xc3\x89t\xc3\xa9", "milk"}));
+
+    InvertedIndex idx;
+    idx.setLowercase(true);
+    idx.updateDocumentBase({"Great milk", "great GREAT water"});
+    ASSERT_EQ(idx.getWordCount("great"), std::vector<Entry>({{0, 1}, {1, 2}}));
+    ASSERT_TRUE(idx.getWordCount("Great").empty());
+    const std::string path = "test_index.bin";
+    ASSERT_EQ(idx.save(path), status::OK);
+    InvertedIndex loaded;
+    ASSERT_EQ(loaded.load(path), status::OK);
+    std::remove(path.c_str());
+    ASSERT_TRUE(loaded.isLowercase());
+    auto result = SearchServer(loaded).search({"GrEaT"});
+    ASSERT_EQ(result, std::vector<std::vector<RelativeIndex>>({{{1, 1}, {0, 0.5}}}));
+}
+//-----------------------------------
+
+//Test for the index file-----------
+TEST(TestCaseIndexFile, TestSaveAndLoad) {
+    std::vector<std::string> docs;
+    std::mt19937 random(7);
+    for (int i = 0; i < 300; i++) {
+        std::string doc;
+        for (int j = 0; j < 200; j++)
+            doc += "w" + std::to_string(random() % (j % 2 == 0 ? 10 : 2000)) + " ";
+        docs.push_back(doc);
+    }
+    InvertedIndex built;
+    built.updateDocumentBase(docs);
+    built.setSources({{"a.txt", 10, 20}, {"b.txt", 0, -1}});
+    const std::string path = "test_index.bin";
+    ASSERT_EQ(built.save(path), status::OK);
+
+    InvertedIndex loaded;
+    ASSERT_EQ(loaded.load(path, true), status::OK);
+    ASSERT_EQ(loaded.getDocsAmount(), built.getDocsAmount());
+    ASSERT_TRUE(loaded.getSources() == built.getSources());
+    for (int word = 0; word <= 2000; word++) {
+        std::string term = "w" + std::to_string(word);
+        ASSERT_EQ(loaded.getWordCount(term), built.getWordCount(term));
+    }
+
+    const std::vector<std::string> requests = {"w1 w2 w1500", "w3", "w1999 w7 w8 w9", "missing"};
+    ASSERT_EQ(SearchServer(loaded).search(requests), SearchServer(built).search(requests));
+    std::remove(path.c_str());
+}
+
+TEST(TestCaseIndexFile, TestDamagedFileIsRejected) {
+    InvertedIndex built;
+    built.updateDocumentBase({"milk water", "sugar water water"});
+    const std::string path = "test_index.bin";
+    ASSERT_EQ(built.save(path), status::OK);
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    InvertedIndex loaded;
+    loaded.updateDocumentBase({"london"});
+    bytes[bytes.size() - 20] ^= 1;
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    ASSERT_EQ(loaded.load(path, true), status::ERROR);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() / 2);
+    ASSERT_EQ(loaded.load(path, false), status::ERROR);
+    ASSERT_EQ(loaded.getDocsAmount(), 1);
+    ASSERT_EQ(loaded.getWordCount("london"), std::vector<Entry>({{0, 1}}));
+    std::remove(path.c_str());
+    ASSERT_EQ(loaded.load(path, false), status::ERROR);
+
+    ///< Without the checksum the tables used by the lookups are still checked
+    for (auto section : {IndexSection::TermSlots, IndexSection::PostingTerms, IndexSection::PostingBlocks}) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+        size_t offset, size;
+        {
+            IndexFileReader reader;
+            ASSERT_EQ(reader.open(path, false), status::OK);
+            const char *data;
+            ASSERT_TRUE(reader.findSection(section, data, size));
+            offset = data - reader.getFile()->data();
+        }
+        std::string damaged = bytes;
+        std::fill(damaged.begin() + (std::ptrdiff_t) offset, damaged.begin() + (std::ptrdiff_t) (offset + size), '\x3f');
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+        ASSERT_EQ(loaded.load(path, false), status::ERROR) << (uint32_t) section;
+    }
+    std::remove(path.c_str());
+}
+//-----------------------------------
+
+//Test for ConverterJSON class-------
+TEST(TestCaseConverterJSON, TestStreamedRequestsAndAnswers) {
+    const std::string requestsPath = "test_requests.jsonl", answersPath = "test_answers.json";
+    std::ofstream(requestsPath, std::ios::trunc) << "\"milk water\"\n\n{\"request\": \"sugar\"}\n42\n\"london\"";
+    RequestsReader reader;
+    ASSERT_EQ(reader.open(requestsPath), status::OK);
+    std::vector<std::string> requests, batch;
+    while (reader.read(batch, 2) != 0) {
+        ASSERT_LE(batch.size(), 2);
+        requests.insert(requests.end(), batch.begin(), batch.end());
+    }
+    ASSERT_EQ(requests, std::vector<std::string>({"milk water", "sugar", "", "london"}));
+
+    std::vector<std::vector<std::pair<size_t, double>>> answers(120);
+    for (size_t i = 0; i < answers.size(); i++) {
+        for (size_t j = 0; j < i % 3; j++)
+            answers[i].emplace_back(i + j, 1.0 / (j + 1));
+    }
+    AnswersWriter writer;
+    ASSERT_EQ(writer.open(answersPath), status::OK);
+    for (auto &answer : answers)
+        ASSERT_EQ(writer.write(answer), status::OK);
+    ASSERT_EQ(writer.close(), status::OK);
+    std::stringstream written;
+    written << std::ifstream(answersPath).rdbuf();
+    std::stringstream expected;
+    expected << ConverterJSON::getAnswersJson(answers);
+    ASSERT_EQ(written.str(), expected.str());
+    std::remove(requestsPath.c_str());
+    std::remove(answersPath.c_str());
+}
+//-----------------------------------
+
+//Test for FileExchange class--------
+TEST(TestCaseFileExchange, TestTextFileViews) {
+    const std::string path = "test_document.txt";
+    const std::string content = "milk  water\r\nsugar\twater\n\n";
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+
+    std::string text;
+    ASSERT_EQ(FileExchange::readFromFile(text, path, true), status::OK);
+    auto file = FileExchange::mapTextFile(path);
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_EQ(std::string(file->data(), file->size()), content);
+    ASSERT_TRUE(FileExchange::canOpen(path));
+
+    InvertedIndex fromString, fromView;
+    fromString.updateDocumentBase({text});
+    fromView.updateDocumentBaseViews({TextView(file->data(), file->size())});
+    file.reset();
+    for (auto word : {"milk", "water", "sugar"})
+        ASSERT_EQ(fromView.getWordCount(word), fromString.getWordCount(word)) << word;
+    ASSERT_EQ(fromView.getWordCount("water"), std::vector<Entry>({{0, 2}}));
+    std::remove(path.c_str());
+    ASSERT_TRUE(FileExchange::mapTextFile(path) == nullptr);
+    ASSERT_FALSE(FileExchange::canOpen(path));
+}
+//-----------------------------------
+
+//Test for IngestPipeline class-------
+TEST(TestCaseIngestPipeline, TestMatchesInMemoryIndexing) {
+    std::vector<std::string> docs;
+    std::mt19937 random(11);
+    for (int i = 0; i < 6; i++) {
+        std::string doc;
+        for (int j = 0; j < 3000; j++)
+            doc += "w" + std::to_string(random() % (j % 3 == 0 ? 20 : 500)) + (j % 7 == 0 ? "\n" : " ");
+        docs.push_back(doc);
+    }
+    docs.emplace_back();
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < docs.size(); i++) {
+        paths.push_back("test_ingest" + std::to_string(i) + ".txt");
+        std::ofstream(paths.back(), std::ios::binary | std::ios::trunc) << docs[i];
+    }
+    ///< A missing file is skipped and the next files take its docId
+    paths.insert(paths.begin() + 2, "test_ingest_missing.txt");
+
+    InvertedIndex expected;
+    expected.updateDocumentBase(docs);
+    IngestSettings settings;
+    settings.readers = 2;
+    settings.tokenizers = 3;
+    settings.indexers = 2;
+    settings.queueDepth = 2;
+    settings.blockSize = 1000; ///< small blocks cut every document into many
+    IngestPipeline pipeline(settings);
+    InvertedIndex ingested;
+    pipeline.run(paths, ingested);
+
+    ASSERT_EQ(ingested.getDocsAmount(), docs.size());
+    for (int word = 0; word < 500; word++) {
+        std::string term = "w" + std::to_string(word);
+        ASSERT_EQ(ingested.getWordCount(term), expected.getWordCount(term)) << term;
+    }
+    const IngestStats &stats = pipeline.getStats();
+    ASSERT_EQ(stats.stages.size(), 3);
+    for (auto &stage : stats.stages) {
+        ASSERT_EQ(stage.blocks, stats.stages[0].blocks) << stage.name;
+        ASSERT_GT(stage.blocks, docs.size());
+    }
+    ASSERT_LE(stats.readQueue.maxDepth, 2);
+    ASSERT_LE(stats.tokenQueue.maxDepth, 2);
+    for (auto &path : paths)
+        std::remove(path.c_str());
+}
+
+TEST(TestCaseIngestPipeline, TestBudgetBuildMatchesInMemoryFile) {
+    std::vector<std::string> paths;
+    std::mt19937 random(17);
+    for (int i = 0; i < 8; i++) {
+        std::string doc;
+        for (int j = 0; j < 2000; j++)
+            doc += "w" + std::to_string(random() % (j % 2 == 0 ? 30 : 3000)) + " ";
+        paths.push_back("test_budget" + std::to_string(i) + ".txt");
+        std::ofstream(paths.back(), std::ios::binary | std::ios::trunc) << doc;
+    }
+    IngestSettings settings;
+    settings.indexers = 2;
+    settings.blockSize = 1000;
+
+    InvertedIndex inMemory;
+    IngestPipeline(settings).run(paths, inMemory);
+    ASSERT_EQ(inMemory.save("test_budget_memory.bin"), status::OK);
+
+    ///< A tiny budget writes a run after every block
+    settings.memoryBudget = 1;
+    IngestPipeline pipeline(settings);
+    InvertedIndex built;
+    ASSERT_EQ(pipeline.run(paths, built, "test_budget_runs.bin"), status::OK);
+    ASSERT_GT(pipeline.getStats().runsNum, paths.size());
+    ASSERT_EQ(built.getDocsAmount(), paths.size());
+    for (int word = 0; word < 3000; word += 7) {
+        std::string term = "w" + std::to_string(word);
+        ASSERT_EQ(built.getWordCount(term), inMemory.getWordCount(term)) << term;
+    }
+
+    std::ifstream memoryFile("test_budget_memory.bin", std::ios::binary), runsFile("test_budget_runs.bin", std::ios::binary);
+    std::string memoryBytes((std::istreambuf_iterator<char>(memoryFile)), std::istreambuf_iterator<char>());
+    std::string runsBytes((std::istreambuf_iterator<char>(runsFile)), std::istreambuf_iterator<char>());
+    ASSERT_FALSE(memoryBytes.empty());
+    ASSERT_TRUE(memoryBytes == runsBytes);
+    ///< The runs and the temporary files are removed
+    ASSERT_FALSE(std::ifstream("test_budget_runs.bin.run0").is_open());
+    ASSERT_FALSE(std::ifstream("test_budget_runs.bin.docs").is_open());
+
+    built = InvertedIndex();
+    std::remove("test_budget_memory.bin");
+    std::remove("test_budget_runs.bin");
+    for (auto &path : paths)
+        std::remove(path.c_str());
+}
+
+TEST(TestCaseIngestPipeline, TestPositionsMatchInMemoryIndexing) {
+    std::vector<std::string> docs, paths;
+    std::mt19937 random(23);
+    for (int i = 0; i < 5; i++) {
+        std::string doc;
+        for (int j = 0; j < 1500; j++)
+            doc += "w" + std::to_string(random() % 8) + (j % 5 == 0 ? "\n" : " ");
+        docs.push_back(doc);
+        paths.push_back("test_positions" + std::to_string(i) + ".txt");
+        std::ofstream(paths.back(), std::ios::binary | std::ios::trunc) << doc;
+    }
+    InvertedIndex expected;
+    expected.setPositions(true);
+    expected.updateDocumentBase(docs);
+
+    IngestSettings settings;
+    settings.tokenizers = 3;
+    settings.indexers = 2;
+    settings.blockSize = 700; ///< the positions of a document are numbered across many blocks
+    InvertedIndex ingested;
+    ingested.setPositions(true);
+    IngestPipeline(settings).run(paths, ingested);
+    ///< The runs hold no positions, so the budget build indexes in memory and saves the file
+    settings.memoryBudget = 1;
+    InvertedIndex budgeted;
+    budgeted.setPositions(true);
+    ASSERT_EQ(IngestPipeline(settings).run(paths, budgeted, "test_positions.bin"), status::OK);
+    ASSERT_TRUE(budgeted.hasPositions());
+
+    const std::vector<std::string> requests = {"\"w1 w2\"", "\"w3 w3 w4\"~2 w5", "\"w7 w0 w6 w1\"~1", "\"w2 w2\""};
+    auto result = SearchServer(expected).searchAbsolute(requests);
+    ASSERT_EQ(SearchServer(ingested).searchAbsolute(requests), result);
+    ASSERT_EQ(SearchServer(budgeted).searchAbsolute(requests), result);
+    budgeted = InvertedIndex();
+    std::remove("test_positions.bin");
+    for (auto &path : paths)
+        std::remove(path.c_str());
+}
+//-----------------------------------
+
+//Test for LruCache class------------
+TEST(TestCaseLruCache, TestEvictsLeastRecentlyUsed) {
+    LruCache<int> cache(16); ///< one item per shard
+    std::vector<std::string> keys;
+    for (int i = 0; keys.size() < 3; i++) {
+        std::string key = "k" + std::to_string(i);
+        if (std::hash<std::string>()(key) % 16 == std::hash<std::string>()("k0") % 16)
+            keys.push_back(key);
+    }
+    int value = 0;
+    cache.put(keys[0], 1);
+    ASSERT_TRUE(cache.get(keys[0], value));
+    ASSERT_EQ(value, 1);
+    cache.put(keys[1], 2);
+    ASSERT_FALSE(cache.get(keys[0], value));
+    ASSERT_TRUE(cache.get(keys[1], value));
+    ASSERT_EQ(value, 2);
+
+    cache.setCapacity(32);
+    cache.put(keys[2], 3);
+    ASSERT_TRUE(cache.get(keys[1], value));
+    cache.put(keys[0], 1);
+    ASSERT_FALSE(cache.get(keys[2], value));
+    CacheStats stats = cache.getStats();
+    ASSERT_EQ(stats.size, 2);
+    ASSERT_EQ(stats.hits, 3);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.evictions, 2);
+    cache.setCapacity(0);
+    cache.put(keys[2], 3);
+    ASSERT_EQ(cache.getStats().size, 0);
+}
+
+TEST(TestCaseLruCache, TestCapacityAndVersions) {
+    for (size_t capacity : {1, 5, 16, 21}) {
+        LruCache<int> cache(capacity);
+        for (int i = 0; i < 200; i++)
+            cache.put("k" + std::to_string(i), i);
+        ASSERT_EQ(cache.getStats().size, capacity);
+    }
+
+    ///< An item of another version is a miss and is dropped
+    LruCache<int> cache(4);
+    int value = 0;
+    cache.put("k", 1, 7);
+    ASSERT_FALSE(cache.get("k", value, 8));
+    ASSERT_FALSE(cache.get("k", value, 7));
+    cache.put("k", 2, 8);
+    ASSERT_TRUE(cache.get("k", value, 8));
+    ASSERT_EQ(value, 2);
+    CacheStats stats = cache.getStats();
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.size, 1);
+}
+//-----------------------------------
+
+//Test for ThreadPool class----------
+TEST(TestCaseThreadPool, TestParallelForVisitsEveryIndex) {
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> visits(1000);
+    for (auto &visit : visits)
+        visit = 0;
+    pool.parallelFor(visits.size(), [&visits](size_t i) {
+        visits[i]++;
+    });
+    for (auto &visit : visits)
+        ASSERT_EQ(visit, 1);
+}
+
+TEST(TestCaseThreadPool, TestNestedParallelFor) {
+    ThreadPool pool(2);
+    std::atomic<size_t> sum(0);
+    pool.parallelFor(8, [&pool, &sum](size_t i) {
+        pool.parallelFor(100, [&sum, i](size_t j) {
+            sum += i * 100 + j;
+        });
+    });
+    ASSERT_EQ(sum, 800 * 799 / 2);
+}
+
+TEST(TestCaseThreadPool, TestExceptionIsRethrown) {
+    ThreadPool pool(3);
+    ASSERT_THROW(pool.parallelFor(100, [](size_t i) {
+        if (i == 42)
+            throw std::runtime_error("task failed");
+    }), std::runtime_error);
+    pool.setThreadsNumber(1);
+    ASSERT_EQ(pool.getThreadsNumber(), 1);
+}
+//-----------------------------------
+
+//Test for Metrics class-------------
+TEST(TestCaseMetrics, TestSearchIsCounted) {
+    if (!Metrics::isEnabled())
+        GTEST_SKIP() << "the metrics are compiled out";
+    InvertedIndex idx;
+    idx.updateDocumentBase({"milk sugar salt", "milk water", "water salt"});
+    SearchServer srv(idx);
+    MetricsSnapshot before = Metrics::collect();
+    srv.search({"milk water", "salt", "bread"});
+    MetricsSnapshot after = Metrics::collect();
+
+    auto query = (size_t) MetricStage::Query;
+    ASSERT_EQ(after.stages[query].calls - before.stages[query].calls, 3);
+    uint64_t bucketCalls = 0;
+    for (uint64_t calls : after.stages[query].buckets)
+        bucketCalls += calls;
+    ASSERT_EQ(bucketCalls, after.stages[query].calls);
+    ASSERT_GT(after.counters[(size_t) MetricCounter::PostingsScanned],
+              before.counters[(size_t) MetricCounter::PostingsScanned]);
+
+    std::string text = Metrics::getPrometheusText();
+    ASSERT_NE(text.find("search_engine_stage_seconds_count{stage=\"query\"} "), std::string::npos);
+    ASSERT_NE(text.find("search_engine_stage_seconds_bucket{stage=\"query\",le=\"+Inf\"} "), std::string::npos);
+    ASSERT_GE(Metrics::getJson()["stages"]["query"]["calls"].get<uint64_t>(), 3);
+}
 //-----------------------------------